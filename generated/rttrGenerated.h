@@ -3,7 +3,7 @@
 #include <rttr/registration.h>
 #include <iostream>
 #include "../test/example.h"
-#include "../test/example1.h"
+#include "../test/example2.h"
 
 RTTR_REGISTRATION
 {
@@ -36,6 +36,10 @@ RTTR_REGISTRATION
 		.property_readonly("b", &RttrAutoRegisterTestClass5::getB)
 		.property_readonly("c", &RttrAutoRegisterTestClass5::getC);
 
+	registration::class_<RttrAutoRegisterTestClass6>("RttrAutoRegisterTestClass6")
+		.property("a", &RttrAutoRegisterTestClass6::a)
+		.property("b", &RttrAutoRegisterTestClass6::b);
+
 	registration::enumeration<RttrAutoRegisterTestEnum>("RttrAutoRegisterTestEnum")
      (
 		value("TestEnum1", RttrAutoRegisterTestEnum::TestEnum1),
@@ -0,0 +1,85 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "annotationExtractor.h"
+
+namespace Register {
+
+std::vector<std::string> GetAnnotationDefines(const std::vector<std::string>& registerMacros) {
+  std::vector<std::string> defines;
+  for (const auto& macro : registerMacros) {
+    defines.push_back("-D" + macro + "=__attribute__((annotate(\"" + RegisterAnnotation + "\")))");
+  }
+  defines.push_back(std::string("-DRTTR_SKIP_REGISTER_PROPERTY=__attribute__((annotate(\"") +
+                    SkipPropertyAnnotation + "\")))");
+  // 属性名是字符串字面量, 与前缀拼接成一个字符串; 宏的用法不带分号, 因此由展开补上
+  defines.push_back(std::string("-DRTTR_REGISTER_FUNCTION_AS_PROPERTY(propertyName,function)="
+                                "static_assert(true, \"") +
+                    PropertyAnnotationPrefix + "\" propertyName \":\" #function);");
+  return defines;
+}
+
+struct AnnotatedDeclarations {
+  // Marked classes and enums in declaration order.
+  std::vector<CXCursor> marked;
+};
+
+static CXChildVisitResult VisitAnnotatedDeclaration(CXCursor cursor, CXCursor parent,
+                                                    CXClientData client_data) {
+  auto data = static_cast<AnnotatedDeclarations*>(client_data);
+  CXCursorKind kind = clang_getCursorKind(cursor);
+  if (kind == CXCursor_AnnotateAttr) {
+    // 属性总是先于声明的其他子节点被访问, 因此标记顺序与声明顺序一致
+    ClangString spelling(clang_getCursorSpelling(cursor));
+    CXCursorKind parentKind = clang_getCursorKind(parent);
+    if (spelling.str() == RegisterAnnotation &&
+        (parentKind == CXCursor_ClassDecl || parentKind == CXCursor_StructDecl ||
+         parentKind == CXCursor_EnumDecl)) {
+      data->marked.push_back(parent);
+    }
+    return CXChildVisit_Continue;
+  }
+  if (!clang_Location_isFromMainFile(clang_getCursorLocation(cursor))) {
+    return CXChildVisit_Continue;
+  }
+  switch (kind) {
+    case CXCursor_Namespace:
+    case CXCursor_LinkageSpec:
+    case CXCursor_ClassDecl:
+    case CXCursor_StructDecl:
+    case CXCursor_EnumDecl:
+      return CXChildVisit_Recurse;
+    default:
+      return CXChildVisit_Continue;
+  }
+}
+
+void ExtractFromAnnotations(CXTranslationUnit tu, std::vector<RTTRMarkClassInfo>& classInfos,
+                            std::vector<RTTRMarkEnumInfo>& enumInfos) {
+  AnnotatedDeclarations data;
+  clang_visitChildren(clang_getTranslationUnitCursor(tu), VisitAnnotatedDeclaration, &data);
+  for (const auto& cursor : data.marked) {
+    if (clang_getCursorKind(cursor) == CXCursor_EnumDecl) {
+      ExtractEnumInfo(cursor, enumInfos);
+    } else {
+      ExtractClassInfo(cursor, classInfos, true);
+    }
+  }
+}
+
+}  // namespace Register
@@ -0,0 +1,39 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "register.h"
+
+namespace Register {
+
+// Returns the -D arguments that define the marker macros as annotations instead of empty macros:
+// each of registerMacros becomes __attribute__((annotate("rttr:register"))),
+// RTTR_SKIP_REGISTER_PROPERTY becomes __attribute__((annotate("rttr:skip"))), and
+// RTTR_REGISTER_FUNCTION_AS_PROPERTY becomes a static_assert carrying the property and function
+// names in its message. The headers must only define the macros if they are not defined yet.
+std::vector<std::string> GetAnnotationDefines(const std::vector<std::string>& registerMacros);
+
+// Extracts the marked classes and enums of the main file in a single walk over its declarations.
+// The translation unit must be parsed with the arguments of GetAnnotationDefines().
+void ExtractFromAnnotations(CXTranslationUnit tu, std::vector<RTTRMarkClassInfo>& classInfos,
+                            std::vector<RTTRMarkEnumInfo>& enumInfos);
+
+}  // namespace Register
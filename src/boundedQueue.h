@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace Register {
+
+// Blocking multi-producer, multi-consumer queue that holds at most capacity items, so a fast
+// stage waits for a slow one instead of buffering without limit.
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {
+  }
+
+  // Blocks while the queue is full. Returns false if the queue was closed.
+  bool Push(T value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+    if (closed) {
+      return false;
+    }
+    items.push_back(std::move(value));
+    notEmpty.notify_one();
+    return true;
+  }
+
+  // Blocks while the queue is empty. Returns false once it is closed and drained.
+  bool Pop(T& value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+    if (items.empty()) {
+      return false;
+    }
+    value = std::move(items.front());
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+  // Wakes every waiting consumer and producer. Items already queued can still be popped.
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    notEmpty.notify_all();
+    notFull.notify_all();
+  }
+
+ private:
+  size_t capacity;
+  bool closed = false;
+  std::deque<T> items;
+  std::mutex mutex;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+};
+
+}  // namespace Register
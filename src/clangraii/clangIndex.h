@@ -25,7 +25,8 @@
 namespace Register {
 class ClangIndex {
  public:
-  ClangIndex() : index(clang_createIndex(0, 0)) {
+  // Declarations that come from a precompiled header are not visited.
+  ClangIndex() : index(clang_createIndex(1, 0)) {
   }
   ~ClangIndex() {
     if (index) clang_disposeIndex(index);
@@ -23,6 +23,7 @@
 
 #include <clang-c/Index.h>
 #include <string>
+#include <string_view>
 
 namespace Register {
 class ClangString {
@@ -37,6 +38,12 @@ class ClangString {
     return std::string(clang_getCString(str_));
   }
 
+  // Valid until this object is destroyed.
+  std::string_view view() const {
+    const char* cstr = clang_getCString(str_);
+    return cstr ? std::string_view(cstr) : std::string_view();
+  }
+
   operator std::string() const {
     return str();
   }
@@ -29,17 +29,21 @@ namespace Register {
 class TranslationUnit {
  public:
   TranslationUnit(CXIndex index, const std::string& filename,
-                  const std::vector<const char*>& args) {
+                  const std::vector<const char*>& args, unsigned options = CXTranslationUnit_None,
+                  std::vector<CXUnsavedFile> unsavedFiles = {}) {
 
-    tu_ = clang_parseTranslationUnit(index, filename.c_str(), args.data(),
-                                     static_cast<int>(args.size()), nullptr, 0,
-                                     CXTranslationUnit_None);
+    error_ = clang_parseTranslationUnit2(
+        index, filename.c_str(), args.data(), static_cast<int>(args.size()),
+        unsavedFiles.data(), static_cast<unsigned>(unsavedFiles.size()), options, &tu_);
   }
 
   ~TranslationUnit() {
     if (tu_) clang_disposeTranslationUnit(tu_);
   }
 
+  TranslationUnit(const TranslationUnit&) = delete;
+  TranslationUnit& operator=(const TranslationUnit&) = delete;
+
   operator CXTranslationUnit() const {
     return tu_;
   }
@@ -47,7 +51,28 @@ class TranslationUnit {
     return tu_ != nullptr;
   }
 
+  CXErrorCode error() const {
+    return error_;
+  }
+
+  // Reparses the file with the same arguments, reusing the precompiled preamble if one was built.
+  // libclang leaves the translation unit unusable after a failed reparse, so it is disposed then.
+  bool Reparse() {
+    if (!tu_) {
+      return false;
+    }
+    int result = clang_reparseTranslationUnit(tu_, 0, nullptr, clang_defaultReparseOptions(tu_));
+    if (result != 0) {
+      clang_disposeTranslationUnit(tu_);
+      tu_ = nullptr;
+      error_ = static_cast<CXErrorCode>(result);
+      return false;
+    }
+    return true;
+  }
+
  private:
   CXTranslationUnit tu_ = nullptr;
+  CXErrorCode error_ = CXError_Success;
 };
 }  // namespace Register
@@ -0,0 +1,51 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Register {
+constexpr uint64_t HashSeed = 14695981039346656037ULL;
+
+// 64-bit FNV-1a. Not cryptographic, only used to detect changed inputs.
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = HashSeed) {
+  auto bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+inline uint64_t HashString(const std::string& str, uint64_t hash = HashSeed) {
+  // Hash the length too, so that {"ab", "c"} and {"a", "bc"} differ.
+  uint64_t size = str.size();
+  hash = HashBytes(&size, sizeof(size), hash);
+  return HashBytes(str.data(), str.size(), hash);
+}
+
+inline uint64_t HashStrings(const std::vector<std::string>& strs, uint64_t hash = HashSeed) {
+  for (const auto& str : strs) {
+    hash = HashString(str, hash);
+  }
+  return hash;
+}
+}  // namespace Register
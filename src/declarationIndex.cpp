@@ -0,0 +1,106 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "declarationIndex.h"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+static std::string NormalizePath(const std::string& path) {
+  std::error_code ec;
+  fs::path absolutePath = fs::absolute(path, ec);
+  return (ec ? fs::path(path) : absolutePath).lexically_normal().generic_string();
+}
+
+DeclarationIndex::DeclarationIndex(const std::vector<std::string>& headFiles,
+                                   const std::vector<HeaderParseResult>& results)
+    : results(results) {
+  for (const auto& headFile : headFiles) {
+    headerPaths.push_back(NormalizePath(headFile));
+  }
+  for (size_t i = 0; i < results.size(); ++i) {
+    for (const auto& usr : results[i].definedTypes) {
+      definingHeaders.emplace(usr, i);
+    }
+  }
+}
+
+bool DeclarationIndex::Add(const std::string& usr, std::set<size_t>& headers) const {
+  auto iter = definingHeaders.find(usr);
+  if (iter == definingHeaders.end()) {
+    return false;
+  }
+  headers.insert(iter->second);
+  return true;
+}
+
+void DeclarationIndex::CollectRequiredHeaders(const HeaderParseResult& result, size_t source,
+                                              std::set<size_t>& headers) const {
+  for (const auto& info : result.classInfos) {
+    if (!Add(info.usr, headers)) {
+      headers.insert(source);
+    }
+    for (const auto& usr : info.propertyTypeUSRs) {
+      Add(usr, headers);
+    }
+  }
+  for (const auto& info : result.enumInfos) {
+    if (!Add(info.usr, headers)) {
+      headers.insert(source);
+    }
+  }
+}
+
+void DeclarationIndex::RemoveIncludedHeaders(std::set<size_t>& headers) const {
+  std::unordered_map<std::string, size_t> headerIndices;
+  for (size_t header : headers) {
+    if (header < headerPaths.size()) {
+      headerIndices.emplace(headerPaths[header], header);
+    }
+  }
+  // 每个头文件包含了集合中的哪些其他头文件
+  std::unordered_map<size_t, std::set<size_t>> includedHeaders;
+  for (size_t header : headers) {
+    if (header >= results.size()) {
+      continue;
+    }
+    for (const auto& file : results[header].includedFiles) {
+      auto iter = headerIndices.find(NormalizePath(file));
+      if (iter != headerIndices.end() && iter->second != header) {
+        includedHeaders[header].insert(iter->second);
+      }
+    }
+  }
+  // 互相包含时只移除前面的, 保证至少保留一个
+  std::set<size_t> removed;
+  for (size_t header : headers) {
+    for (const auto& [includer, included] : includedHeaders) {
+      if (removed.count(includer) == 0 && included.count(header) > 0) {
+        removed.insert(header);
+        break;
+      }
+    }
+  }
+  for (size_t header : removed) {
+    headers.erase(header);
+  }
+}
+
+}  // namespace Register
@@ -0,0 +1,59 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+// Maps the USR of every class, struct and enum defined in a parsed header to that header, so the
+// generated code can include only the headers that define what it registers.
+class DeclarationIndex {
+ public:
+  // results[i] belongs to headFiles[i] and must outlive the index. A type defined in several
+  // headers maps to the first one.
+  DeclarationIndex(const std::vector<std::string>& headFiles,
+                   const std::vector<HeaderParseResult>& results);
+
+  // Adds the headers that define the classes and enums of result and the types of their
+  // properties. source is the header the result belongs to, used for registered types that are
+  // missing from the index. Property types defined outside the parsed headers are left to the
+  // includes of the headers that use them.
+  void CollectRequiredHeaders(const HeaderParseResult& result, size_t source,
+                              std::set<size_t>& headers) const;
+
+  // Removes the headers that another one of headers already includes, directly or through other
+  // files, according to the recorded includedFiles. Of headers that include each other, only the
+  // last one is kept.
+  void RemoveIncludedHeaders(std::set<size_t>& headers) const;
+
+ private:
+  const std::vector<HeaderParseResult>& results;
+  // Normalized absolute path of every header.
+  std::vector<std::string> headerPaths;
+  std::unordered_map<std::string, size_t> definingHeaders;
+
+  bool Add(const std::string& usr, std::set<size_t>& headers) const;
+};
+
+}  // namespace Register
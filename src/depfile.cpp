@@ -0,0 +1,85 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "depfile.h"
+#include <iostream>
+#include <set>
+#include "outputFile.h"
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+static std::string NormalizePath(const std::string& path) {
+  std::error_code ec;
+  fs::path absolutePath = fs::absolute(path, ec);
+  return (ec ? fs::path(path) : absolutePath).lexically_normal().generic_string();
+}
+
+// 转义 Make 和 Ninja 都会特殊处理的字符
+static std::string EscapePath(const std::string& path) {
+  std::string escaped;
+  for (char c : path) {
+    if (c == ' ' || c == '#') {
+      escaped += '\\';
+    } else if (c == '$') {
+      escaped += '$';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+std::vector<std::string> CollectDependencies(const std::vector<std::string>& inputFiles,
+                                             const std::vector<HeaderParseResult>& results) {
+  std::set<std::string> dependencies;
+  for (const auto& file : inputFiles) {
+    dependencies.insert(NormalizePath(file));
+  }
+  for (const auto& result : results) {
+    for (const auto& file : result.includedFiles) {
+      dependencies.insert(NormalizePath(file));
+    }
+  }
+  return {dependencies.begin(), dependencies.end()};
+}
+
+bool WriteDepfile(const fs::path& depfile, const fs::path& target,
+                  const std::vector<std::string>& dependencies) {
+  std::string contents = EscapePath(target.generic_string()) + ":";
+  for (const auto& dependency : dependencies) {
+    contents += " \\\n  " + EscapePath(dependency);
+  }
+  contents += "\n";
+  return WriteFileIfChanged(depfile, contents) != WriteStatus::Failed;
+}
+
+bool TouchStampFile(const fs::path& stamp) {
+  std::error_code ec;
+  if (!fs::exists(stamp, ec)) {
+    return WriteFileIfChanged(stamp, "") != WriteStatus::Failed;
+  }
+  fs::last_write_time(stamp, fs::file_time_type::clock::now(), ec);
+  if (ec) {
+    std::cerr << "Error: Failed to touch " << stamp << ": " << ec.message() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace Register
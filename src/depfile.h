@@ -0,0 +1,45 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+// Returns the sorted, normalized absolute paths of the files the generated code depends on: the
+// input files, i.e. the searched headers including those skipped by the prefilter, since adding
+// a marker to them changes the output, and every file included by a parsed header, whether it
+// was parsed in this run or served from the cache.
+std::vector<std::string> CollectDependencies(const std::vector<std::string>& inputFiles,
+                                             const std::vector<HeaderParseResult>& results);
+
+// Writes a Make/Ninja depfile that makes target depend on dependencies, in the format expected
+// by add_custom_command(DEPFILE). The file is only replaced when its contents change.
+bool WriteDepfile(const std::filesystem::path& depfile, const std::filesystem::path& target,
+                  const std::vector<std::string>& dependencies);
+
+// Creates the stamp file or sets its modification time to now. The generated code is not
+// rewritten when it is unchanged, so a build system that only compares modification times
+// needs a stamp file as the target of the command, with the generated files as byproducts.
+bool TouchStampFile(const std::filesystem::path& stamp);
+
+}  // namespace Register
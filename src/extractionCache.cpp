@@ -0,0 +1,159 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "extractionCache.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "contentHash.h"
+#include "mappedFile.h"
+#include "resultSerializer.h"
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+// Bump when the entry layout or the extraction logic changes, to drop all old entries.
+static const char* CacheVersion = "rttr-cache-2";
+
+ExtractionCache::ExtractionCache(std::string cacheDir, const ProcessOptions& options)
+    : cacheDir(std::move(cacheDir)) {
+  optionsHash = HashString(CacheVersion);
+  optionsHash = HashStrings(options.args, optionsHash);
+  optionsHash = HashStrings(options.registerMacros, optionsHash);
+  uint64_t parseMode = static_cast<uint64_t>(options.parseMode);
+  optionsHash = HashBytes(&parseMode, sizeof(parseMode), optionsHash);
+  uint64_t extraction = static_cast<uint64_t>(options.extraction);
+  optionsHash = HashBytes(&extraction, sizeof(extraction), optionsHash);
+  uint8_t syntactic = options.syntactic ? 1 : 0;
+  optionsHash = HashBytes(&syntactic, sizeof(syntactic), optionsHash);
+  // 预编译头的内容不会出现在包含列表中, 单独计入
+  for (size_t i = 0; i + 1 < options.args.size(); ++i) {
+    uint64_t pchHash = 0;
+    if (options.args[i] == "-include-pch" && GetFileHash(options.args[i + 1], pchHash)) {
+      optionsHash = HashBytes(&pchHash, sizeof(pchHash), optionsHash);
+    }
+  }
+  std::error_code ec;
+  fs::create_directories(this->cacheDir, ec);
+}
+
+bool ExtractionCache::GetFileHash(const std::string& path, uint64_t& hash) {
+  {
+    std::lock_guard<std::mutex> lock(hashMutex);
+    auto iter = fileHashes.find(path);
+    if (iter != fileHashes.end()) {
+      hash = iter->second;
+      return true;
+    }
+  }
+  MappedFile file(path);
+  if (!file) {
+    return false;
+  }
+  hash = HashBytes(file.data(), file.size());
+  std::lock_guard<std::mutex> lock(hashMutex);
+  fileHashes.emplace(path, hash);
+  return true;
+}
+
+std::string ExtractionCache::GetEntryPath(const std::string& headerFile) const {
+  uint64_t pathHash = HashString(fs::absolute(headerFile).lexically_normal().string());
+  std::ostringstream name;
+  name << std::hex << pathHash << ".entry";
+  return (fs::path(cacheDir) / name.str()).string();
+}
+
+bool ExtractionCache::Load(const std::string& headerFile, HeaderParseResult& result) {
+  std::ifstream in(GetEntryPath(headerFile), std::ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+  uint64_t headerHash = 0;
+  if (!GetFileHash(headerFile, headerHash)) {
+    return false;
+  }
+  std::string version;
+  std::string path;
+  uint64_t storedOptionsHash = 0;
+  uint64_t storedHeaderHash = 0;
+  if (!ReadString(in, version) || version != CacheVersion || !ReadString(in, path) ||
+      path != headerFile || !(in >> storedOptionsHash >> storedHeaderHash) ||
+      storedOptionsHash != optionsHash || storedHeaderHash != headerHash) {
+    return false;
+  }
+
+  size_t count = 0;
+  if (!(in >> count)) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t storedHash = 0;
+    std::string includedFile;
+    uint64_t currentHash = 0;
+    if (!(in >> storedHash) || !ReadString(in, includedFile) ||
+        !GetFileHash(includedFile, currentHash) || currentHash != storedHash) {
+      return false;
+    }
+  }
+  return ReadHeaderResult(in, result);
+}
+
+void ExtractionCache::Store(const std::string& headerFile, const HeaderParseResult& result) {
+  uint64_t headerHash = 0;
+  if (!result.parsed || !GetFileHash(headerFile, headerHash)) {
+    return;
+  }
+  std::ostringstream out;
+  WriteString(out, CacheVersion);
+  WriteString(out, headerFile);
+  out << optionsHash << ' ' << headerHash << '\n';
+  out << result.includedFiles.size() << '\n';
+  for (const auto& includedFile : result.includedFiles) {
+    uint64_t hash = 0;
+    if (!GetFileHash(includedFile, hash)) {
+      return;
+    }
+    out << hash << ' ';
+    WriteString(out, includedFile);
+  }
+  WriteHeaderResult(out, result);
+
+  // 先写临时文件再重命名, 并发运行时不会读到写了一半的条目
+  std::string entryPath = GetEntryPath(headerFile);
+  std::ostringstream tempName;
+  tempName << entryPath << ".tmp" << std::hex << HashString(headerFile, headerHash);
+  std::string tempPath = tempName.str();
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return;
+    }
+    file << out.str();
+    if (!file.good()) {
+      return;
+    }
+  }
+  std::error_code ec;
+  fs::rename(tempPath, entryPath, ec);
+  if (ec) {
+    fs::remove(tempPath, ec);
+  }
+}
+
+}  // namespace Register
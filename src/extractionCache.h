@@ -0,0 +1,53 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+// On-disk cache of extraction results, one entry file per header. An entry is valid while the
+// header contents, the compiler arguments, the register macros and the contents of every file the
+// header transitively includes are unchanged.
+class ExtractionCache {
+ public:
+  ExtractionCache(std::string cacheDir, const ProcessOptions& options);
+
+  bool Load(const std::string& headerFile, HeaderParseResult& result);
+
+  // Stores a result produced by a successful parse. result.includedFiles must be filled in.
+  void Store(const std::string& headerFile, const HeaderParseResult& result);
+
+ private:
+  std::string cacheDir;
+  uint64_t optionsHash = 0;
+  std::mutex hashMutex;
+  // Content hashes of files read during this run, shared by all headers that include them.
+  std::unordered_map<std::string, uint64_t> fileHashes;
+
+  bool GetFileHash(const std::string& path, uint64_t& hash);
+  std::string GetEntryPath(const std::string& headerFile) const;
+};
+
+}  // namespace Register
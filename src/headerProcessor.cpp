@@ -0,0 +1,421 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "headerProcessor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "annotationExtractor.h"
+#include "extractionCache.h"
+#include "macroExtractor.h"
+#include "memoryBudget.h"
+#include "parseStats.h"
+#include "umbrellaUnit.h"
+#include "workerProcesses.h"
+
+namespace Register {
+
+static std::mutex logMutex;
+
+std::vector<const char*> GetArgPointers(const std::vector<std::string>& args) {
+  std::vector<const char*> pointers;
+  pointers.reserve(args.size());
+  for (const auto& arg : args) {
+    pointers.push_back(arg.c_str());
+  }
+  return pointers;
+}
+
+std::vector<std::string> GetSyntacticDefines(const std::vector<std::string>& registerMacros) {
+  std::vector<std::string> defines;
+  for (const auto& macro : registerMacros) {
+    defines.push_back("-D" + macro + "=");
+  }
+  defines.emplace_back("-DRTTR_SKIP_REGISTER_PROPERTY=");
+  defines.emplace_back("-DRTTR_REGISTER_FUNCTION_AS_PROPERTY(propertyName,function)=");
+  return defines;
+}
+
+bool ParseModeFromString(const std::string& name, ParseMode& mode) {
+  if (name == "full") {
+    mode = ParseMode::Full;
+  } else if (name == "fast") {
+    mode = ParseMode::Fast;
+  } else if (name == "compare") {
+    mode = ParseMode::Compare;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+unsigned GetParseOptions(ParseMode mode) {
+  if (mode == ParseMode::Fast) {
+    // 只需要声明, 函数体和包含文件中的警告都可以忽略
+    return CXTranslationUnit_SkipFunctionBodies | CXTranslationUnit_Incomplete |
+           CXTranslationUnit_KeepGoing | CXTranslationUnit_IgnoreNonErrorsFromIncludedFiles;
+  }
+  return CXTranslationUnit_None;
+}
+
+bool ExtractionEngineFromString(const std::string& name, ExtractionEngine& engine) {
+  if (name == "tokens") {
+    engine = ExtractionEngine::Tokens;
+  } else if (name == "macros") {
+    engine = ExtractionEngine::MacroExpansions;
+  } else if (name == "annotations") {
+    engine = ExtractionEngine::Annotations;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+unsigned GetExtractionParseOptions(ExtractionEngine engine) {
+  if (engine == ExtractionEngine::MacroExpansions) {
+    return CXTranslationUnit_DetailedPreprocessingRecord;
+  }
+  return CXTranslationUnit_None;
+}
+
+void ExtractTranslationUnit(TranslationUnit& tu, const ProcessOptions& options,
+                            HeaderParseResult& result) {
+  if (options.extraction == ExtractionEngine::MacroExpansions) {
+    ExtractFromMacroExpansions(tu, options.registerMacros, result.classInfos, result.enumInfos);
+  } else if (options.extraction == ExtractionEngine::Annotations) {
+    ExtractFromAnnotations(tu, result.classInfos, result.enumInfos);
+  } else {
+    auto tokens = GenerateTokenStream(tu, options.registerMacros);
+    ParseRttrMarkClass(tokens, result.classInfos, result.enumInfos);
+  }
+  result.includedFiles = GetIncludedFiles(tu);
+  auto definedTypes = GetDefinedTypes(tu, true);
+  if (!definedTypes.empty()) {
+    result.definedTypes = std::move(definedTypes.begin()->second);
+  }
+  result.parsed = true;
+}
+
+static bool ExtractHeader(ClangIndex& index, const std::string& headerFile,
+                          const std::vector<const char*>& args, ParseMode parseMode,
+                          const ProcessOptions& options, HeaderParseResult& result) {
+  unsigned parseOptions =
+      GetParseOptions(parseMode) | GetExtractionParseOptions(options.extraction);
+  auto tu = GetTranslationUnit(index, headerFile, args, parseOptions);
+  if (!tu) {
+    std::lock_guard<std::mutex> lock(logMutex);
+    std::cerr << "Failed to parse translation unit\n";
+    return false;
+  }
+
+  uint64_t memoryBytes = GetTranslationUnitMemory(*tu);
+  ExtractTranslationUnit(*tu, options, result);
+  result.memoryBytes = std::max(result.memoryBytes, memoryBytes);
+  return true;
+}
+
+// Extracts the header without parsing its includes. Returns false if that fails, if the header
+// has errors without its includes, if some register marker did not yield a class or enum, or if
+// the result needs type information from the includes.
+static bool ExtractHeaderSyntactically(ClangIndex& index, const std::string& headerFile,
+                                       const std::vector<const char*>& args,
+                                       const ProcessOptions& options, HeaderParseResult& result) {
+  // 包含文件中的类型都无法解析, 必须容忍错误继续解析
+  unsigned parseOptions = GetParseOptions(options.parseMode) |
+                          GetExtractionParseOptions(options.extraction) |
+                          CXTranslationUnit_SingleFileParse | CXTranslationUnit_Incomplete |
+                          CXTranslationUnit_KeepGoing;
+  TranslationUnit tu(index, headerFile, args, parseOptions);
+  if (!tu) {
+    return false;
+  }
+  // 缺少包含文件时的可复制性结论不能写入全局缓存
+  CopyabilityCacheBypass cacheBypass;
+  HeaderParseResult syntacticResult;
+  ExtractTranslationUnit(tu, options, syntacticResult);
+  syntacticResult.memoryBytes = GetTranslationUnitMemory(tu);
+  result.memoryBytes = syntacticResult.memoryBytes;
+  if (NeedsSemanticParse(tu, syntacticResult.classInfos)) {
+    return false;
+  }
+  // 例如来自包含文件的导出宏 "class PAG_API RTTR_AUTO_REGISTER_CLASS Foo" 会导致解析错误并漏掉类型
+  size_t numTypes = syntacticResult.classInfos.size() + syntacticResult.enumInfos.size();
+  if (HasMainFileErrors(tu) || CountRegisterMarkers(tu, options.registerMacros) != numTypes) {
+    return false;
+  }
+  result = std::move(syntacticResult);
+  return true;
+}
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+static bool ProcessHeaderFileUntimed(ClangIndex& index, const std::string& headerFile,
+                                     const std::vector<const char*>& args,
+                                     const ProcessOptions& options, HeaderParseResult& result) {
+  {
+    std::lock_guard<std::mutex> lock(logMutex);
+    std::cout << "Process file : " << headerFile << std::endl;
+  }
+  if (options.parseMode != ParseMode::Compare) {
+    if (options.syntactic) {
+      if (ExtractHeaderSyntactically(index, headerFile, args, options, result)) {
+        return true;
+      }
+      std::lock_guard<std::mutex> lock(logMutex);
+      std::cout << "Parse with includes : " << headerFile << std::endl;
+    }
+    return ExtractHeader(index, headerFile, args, options.parseMode, options, result);
+  }
+
+  ParseModeComparison comparison;
+  auto start = std::chrono::steady_clock::now();
+  if (!ExtractHeader(index, headerFile, args, ParseMode::Full, options, result)) {
+    return false;
+  }
+  comparison.fullMilliseconds = MillisecondsSince(start);
+
+  HeaderParseResult fastResult;
+  start = std::chrono::steady_clock::now();
+  if (ExtractHeader(index, headerFile, args, ParseMode::Fast, options, fastResult)) {
+    comparison.fastMilliseconds = MillisecondsSince(start);
+    comparison.identical = fastResult.classInfos == result.classInfos &&
+                           fastResult.enumInfos == result.enumInfos;
+  }
+  result.comparison = comparison;
+  return true;
+}
+
+bool ProcessHeaderFile(ClangIndex& index, const std::string& headerFile,
+                       const std::vector<const char*>& args, const ProcessOptions& options,
+                       HeaderParseResult& result) {
+  auto start = std::chrono::steady_clock::now();
+  bool success = ProcessHeaderFileUntimed(index, headerFile, args, options, result);
+  result.milliseconds = MillisecondsSince(start);
+  return success;
+}
+
+ParseSchedule GetParseSchedule(const std::vector<std::string>& headFiles,
+                               const ProcessOptions& options) {
+  ParseSchedule schedule;
+  schedule.memoryEstimates.resize(headFiles.size(), 0);
+  ParseStats stats;
+  if (!options.statsFile.empty()) {
+    stats.Load(options.statsFile);
+  }
+  for (size_t i = 0; i < headFiles.size() && !stats.empty(); ++i) {
+    schedule.memoryEstimates[i] = stats.GetMemory(headFiles[i]);
+  }
+  // 串行执行时顺序不影响总时间
+  if (options.statsFile.empty() || (options.jobs == 1 && !options.isolate)) {
+    schedule.order.resize(headFiles.size());
+    for (size_t i = 0; i < schedule.order.size(); ++i) {
+      schedule.order[i] = i;
+    }
+    return schedule;
+  }
+  schedule.order = stats.GetScheduleOrder(headFiles);
+  return schedule;
+}
+
+static bool ProcessEachHeaderFile(const std::vector<std::string>& headFiles,
+                                  const ProcessOptions& options,
+                                  std::vector<HeaderParseResult>& results) {
+  if (options.isolate) {
+    if (IsWorkerIsolationSupported()) {
+      return ProcessInWorkerProcesses(headFiles, options, results);
+    }
+    std::lock_guard<std::mutex> lock(logMutex);
+    std::cerr << "Worker processes are not supported on this platform, using threads\n";
+  }
+  results.clear();
+  results.resize(headFiles.size());
+
+  unsigned jobs = options.jobs;
+  if (jobs == 0) {
+    jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+  jobs = static_cast<unsigned>(std::min<size_t>(jobs, std::max<size_t>(headFiles.size(), 1)));
+
+  ParseSchedule schedule = GetParseSchedule(headFiles, options);
+  MemoryBudget budget(options.maxMemory);
+  std::atomic<size_t> next{0};
+  std::atomic<bool> failed{false};
+  auto worker = [&]() {
+    // libclang allows concurrent use of distinct indexes, so every worker gets its own.
+    ClangIndex index;
+    if (!index) {
+      std::lock_guard<std::mutex> lock(logMutex);
+      std::cerr << "Failed to create Clang index\n";
+      failed = true;
+      return;
+    }
+    auto args = GetArgPointers(options.args);
+    while (!failed) {
+      size_t n = next++;
+      if (n >= schedule.order.size()) {
+        break;
+      }
+      size_t i = schedule.order[n];
+      // 大的翻译单元占用预算时, 其他工作线程等待而不是同时解析
+      uint64_t reservation = schedule.memoryEstimates[i] > 0 ? schedule.memoryEstimates[i]
+                                                             : budget.GetUnknownEstimate();
+      budget.Acquire(reservation);
+      if (!ProcessHeaderFile(index, headFiles[i], args, options, results[i])) {
+        failed = true;
+      }
+      budget.RecordMeasured(results[i].memoryBytes);
+      budget.Release(reservation);
+    }
+  };
+
+  if (jobs <= 1) {
+    worker();
+    return !failed;
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(jobs);
+  for (unsigned i = 0; i < jobs; ++i) {
+    threads.emplace_back(worker);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return !failed;
+}
+
+static bool ParseHeaderFiles(const std::vector<std::string>& headFiles,
+                             const ProcessOptions& options,
+                             std::vector<HeaderParseResult>& results) {
+  if (!options.umbrella || options.syntactic || options.parseMode == ParseMode::Compare) {
+    return ProcessEachHeaderFile(headFiles, options, results);
+  }
+
+  std::vector<size_t> failedHeaders;
+  ProcessUmbrellaUnit(headFiles, options, results, failedHeaders);
+  if (failedHeaders.empty()) {
+    return true;
+  }
+
+  // 伞形单元中出错的头文件单独解析
+  std::cout << "Parse " << failedHeaders.size() << " header(s) on their own\n";
+  std::vector<std::string> fallbackFiles;
+  for (size_t index : failedHeaders) {
+    fallbackFiles.push_back(headFiles[index]);
+  }
+  std::vector<HeaderParseResult> fallbackResults;
+  bool success = ProcessEachHeaderFile(fallbackFiles, options, fallbackResults);
+  for (size_t i = 0; i < failedHeaders.size(); ++i) {
+    results[failedHeaders[i]] = std::move(fallbackResults[i]);
+  }
+  return success;
+}
+
+void UpdateParseStats(const std::vector<std::string>& headFiles,
+                      const std::vector<HeaderParseResult>& results,
+                      const ProcessOptions& options) {
+  if (options.statsFile.empty()) {
+    return;
+  }
+  ParseStats stats;
+  stats.Load(options.statsFile);
+  for (size_t i = 0; i < headFiles.size() && i < results.size(); ++i) {
+    if (results[i].parsed && !results[i].fromCache && results[i].milliseconds > 0) {
+      stats.Record(headFiles[i], results[i].milliseconds, results[i].memoryBytes);
+    }
+  }
+  stats.Save(options.statsFile);
+}
+
+static bool ProcessAndCacheHeaderFiles(const std::vector<std::string>& headFiles,
+                                       const ProcessOptions& options,
+                                       std::vector<HeaderParseResult>& results) {
+  if (options.cacheDir.empty() || options.parseMode == ParseMode::Compare) {
+    return ParseHeaderFiles(headFiles, options, results);
+  }
+
+  ExtractionCache cache(options.cacheDir, options);
+  results.clear();
+  results.resize(headFiles.size());
+  std::vector<size_t> missed;
+  for (size_t i = 0; i < headFiles.size(); ++i) {
+    if (cache.Load(headFiles[i], results[i])) {
+      results[i].fromCache = true;
+    } else {
+      results[i] = {};
+      missed.push_back(i);
+    }
+  }
+  if (missed.empty()) {
+    return true;
+  }
+
+  std::vector<std::string> missedFiles;
+  for (size_t index : missed) {
+    missedFiles.push_back(headFiles[index]);
+  }
+  std::vector<HeaderParseResult> missedResults;
+  bool success = ParseHeaderFiles(missedFiles, options, missedResults);
+  for (size_t i = 0; i < missed.size(); ++i) {
+    cache.Store(missedFiles[i], missedResults[i]);
+    results[missed[i]] = std::move(missedResults[i]);
+  }
+  return success;
+}
+
+bool ProcessHeaderFiles(const std::vector<std::string>& headFiles, const ProcessOptions& options,
+                        std::vector<HeaderParseResult>& results) {
+  bool success = ProcessAndCacheHeaderFiles(headFiles, options, results);
+  UpdateParseStats(headFiles, results, options);
+  return success;
+}
+
+void PrintParseModeComparison(const std::vector<std::string>& headFiles,
+                              const std::vector<HeaderParseResult>& results) {
+  double fullTotal = 0;
+  double fastTotal = 0;
+  size_t mismatches = 0;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Parse mode comparison (full ms / fast ms / result):\n";
+  for (size_t i = 0; i < headFiles.size() && i < results.size(); ++i) {
+    if (!results[i].comparison) {
+      continue;
+    }
+    const auto& comparison = *results[i].comparison;
+    fullTotal += comparison.fullMilliseconds;
+    fastTotal += comparison.fastMilliseconds;
+    if (!comparison.identical) {
+      mismatches++;
+    }
+    std::cout << "  " << comparison.fullMilliseconds << " / " << comparison.fastMilliseconds
+              << " / " << (comparison.identical ? "identical" : "DIFFERENT") << "  "
+              << headFiles[i] << "\n";
+  }
+  std::cout << "Total: full " << fullTotal << " ms, fast " << fastTotal << " ms, " << mismatches
+            << " header(s) with different results\n";
+  std::cout.unsetf(std::ios::floatfield);
+}
+
+}  // namespace Register
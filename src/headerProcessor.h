@@ -0,0 +1,159 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "register.h"
+
+namespace Register {
+
+enum class ParseMode {
+  // Parses everything, including inline function bodies.
+  Full,
+  // Skips function bodies and tolerates errors, since only declarations are extracted.
+  Fast,
+  // Parses every header in both modes and reports timings and whether the results match.
+  Compare
+};
+
+bool ParseModeFromString(const std::string& name, ParseMode& mode);
+
+unsigned GetParseOptions(ParseMode mode);
+
+enum class ExtractionEngine {
+  // Annotates the tokens of the header and scans them for the registration macros.
+  Tokens,
+  // Visits the macro expansions recorded by the preprocessor, see ExtractFromMacroExpansions().
+  MacroExpansions,
+  // Defines the markers as annotation attributes and walks the AST once, see
+  // ExtractFromAnnotations(). options.args must contain GetAnnotationDefines().
+  Annotations
+};
+
+bool ExtractionEngineFromString(const std::string& name, ExtractionEngine& engine);
+
+// Returns the parse options the engine needs on top of those of the parse mode.
+unsigned GetExtractionParseOptions(ExtractionEngine engine);
+
+struct ProcessOptions {
+  // Compiler arguments passed to every translation unit, e.g. "-std=c++17", "-I/path".
+  std::vector<std::string> args;
+  std::vector<std::string> registerMacros;
+  // Number of worker threads, 0 means one per hardware thread.
+  unsigned jobs = 1;
+  ParseMode parseMode = ParseMode::Full;
+  ExtractionEngine extraction = ExtractionEngine::Tokens;
+  // Parses all headers in one umbrella translation unit, see ProcessUmbrellaUnit().
+  bool umbrella = false;
+  // Parses each header on its own with CXTranslationUnit_SingleFileParse first and only parses it
+  // with its includes if a marked class has fields that need type information, see
+  // NeedsSemanticParse(). options.args must contain GetSyntacticDefines(). Overrides umbrella.
+  bool syntactic = false;
+  // Directory of the extraction cache, see ExtractionCache. Empty disables the cache.
+  std::string cacheDir;
+  // Parses the headers in options.jobs worker processes instead of threads, so a header that
+  // crashes libclang does not end the run, see ProcessInWorkerProcesses().
+  bool isolate = false;
+  // Seconds a worker process may spend on one header before it is killed, 0 means no limit. Only
+  // used with isolate.
+  unsigned workerTimeout = 0;
+  // File with the parse times of earlier runs, see ParseStats. The most expensive headers are
+  // started first and the file is updated with the times of this run. Empty disables it.
+  std::string statsFile;
+  // Memory budget in bytes for the translation units parsed at the same time, see MemoryBudget.
+  // 0 means no limit.
+  uint64_t maxMemory = 0;
+};
+
+struct ParseModeComparison {
+  double fullMilliseconds = 0;
+  double fastMilliseconds = 0;
+  bool identical = false;
+};
+
+struct HeaderParseResult {
+  bool parsed = false;
+  std::vector<RTTRMarkClassInfo> classInfos;
+  std::vector<RTTRMarkEnumInfo> enumInfos;
+  // The header and every file it transitively includes.
+  std::vector<std::string> includedFiles;
+  // USRs of the classes, structs and enums defined in the header, see DeclarationIndex.
+  std::vector<std::string> definedTypes;
+  bool fromCache = false;
+  // Wall-clock time spent parsing and extracting the header, 0 if it was not parsed on its own.
+  double milliseconds = 0;
+  // Largest translation unit memory reported by libclang while processing the header.
+  uint64_t memoryBytes = 0;
+  // Only set in ParseMode::Compare, where classInfos and enumInfos hold the full-mode results.
+  std::optional<ParseModeComparison> comparison;
+};
+
+std::vector<const char*> GetArgPointers(const std::vector<std::string>& args);
+
+// Returns the -D arguments that define the marker macros as empty, since a single file parse does
+// not see the header that defines them.
+std::vector<std::string> GetSyntacticDefines(const std::vector<std::string>& registerMacros);
+
+// Extracts the marked classes and enums of an already parsed translation unit with
+// options.extraction. The unit must have been parsed with GetExtractionParseOptions().
+void ExtractTranslationUnit(TranslationUnit& tu, const ProcessOptions& options,
+                            HeaderParseResult& result);
+
+// Parses one header and extracts its marked classes and enums. The index must not be shared with
+// another thread while this runs.
+bool ProcessHeaderFile(ClangIndex& index, const std::string& headerFile,
+                       const std::vector<const char*>& args, const ProcessOptions& options,
+                       HeaderParseResult& result);
+
+struct ParseSchedule {
+  // Indices of the headers in the order they should be started.
+  std::vector<size_t> order;
+  // Recorded translation unit memory of each header, 0 if unknown.
+  std::vector<uint64_t> memoryEstimates;
+};
+
+// Returns the order in which headFiles should be started, by decreasing expected cost from
+// options.statsFile when headers are parsed in parallel and in input order otherwise, and the
+// expected memory of each header for options.maxMemory.
+ParseSchedule GetParseSchedule(const std::vector<std::string>& headFiles,
+                               const ProcessOptions& options);
+
+// Processes all headers, using options.jobs workers that each own their CXIndex, or worker
+// processes with options.isolate. results[i] always belongs to headFiles[i], so merging them in
+// order gives the same output as a serial run. With options.umbrella the headers are parsed
+// together first and only those that fail there are parsed on their own. Headers with a valid cache
+// entry are not parsed at all. With options.statsFile the headers are started in order of
+// decreasing expected cost. With options.maxMemory a header only starts once its expected
+// translation unit memory fits next to those already being parsed. Returns false if any header
+// failed to parse.
+bool ProcessHeaderFiles(const std::vector<std::string>& headFiles, const ProcessOptions& options,
+                        std::vector<HeaderParseResult>& results);
+
+// Records the parse times and memory of the headers parsed in this run in options.statsFile.
+void UpdateParseStats(const std::vector<std::string>& headFiles,
+                      const std::vector<HeaderParseResult>& results, const ProcessOptions& options);
+
+// Prints the per-header timings and mismatches collected in ParseMode::Compare.
+void PrintParseModeComparison(const std::vector<std::string>& headFiles,
+                              const std::vector<HeaderParseResult>& results);
+
+}  // namespace Register
@@ -0,0 +1,110 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "macroExtractor.h"
+#include <algorithm>
+#include <unordered_set>
+
+namespace Register {
+
+struct MacroMarkers {
+  const std::unordered_set<std::string>* registerMacros = nullptr;
+  // Main file offsets of the register macro expansions.
+  std::vector<unsigned> offsets;
+};
+
+struct MarkedDeclarations {
+  const std::vector<unsigned>* offsets = nullptr;
+  std::vector<RTTRMarkClassInfo>* classInfos = nullptr;
+  std::vector<RTTRMarkEnumInfo>* enumInfos = nullptr;
+};
+
+static unsigned GetOffset(CXSourceLocation location) {
+  unsigned offset = 0;
+  clang_getFileLocation(location, nullptr, nullptr, nullptr, &offset);
+  return offset;
+}
+
+static CXChildVisitResult VisitMacroExpansion(CXCursor cursor, CXCursor parent,
+                                              CXClientData client_data) {
+  // 预处理记录只出现在翻译单元的顶层
+  if (clang_getCursorKind(cursor) != CXCursor_MacroExpansion ||
+      !clang_Location_isFromMainFile(clang_getCursorLocation(cursor))) {
+    return CXChildVisit_Continue;
+  }
+  auto markers = static_cast<MacroMarkers*>(client_data);
+  ClangString spelling(clang_getCursorSpelling(cursor));
+  if (markers->registerMacros->count(spelling.str()) > 0) {
+    markers->offsets.push_back(GetOffset(clang_getCursorLocation(cursor)));
+  }
+  return CXChildVisit_Continue;
+}
+
+static bool IsMarked(CXCursor cursor, const std::vector<unsigned>& offsets) {
+  unsigned begin = GetOffset(clang_getRangeStart(clang_getCursorExtent(cursor)));
+  unsigned name = GetOffset(clang_getCursorLocation(cursor));
+  auto iter = std::lower_bound(offsets.begin(), offsets.end(), begin);
+  return iter != offsets.end() && *iter < name;
+}
+
+static CXChildVisitResult VisitDeclaration(CXCursor cursor, CXCursor parent,
+                                           CXClientData client_data) {
+  if (!clang_Location_isFromMainFile(clang_getCursorLocation(cursor))) {
+    return CXChildVisit_Continue;
+  }
+  auto data = static_cast<MarkedDeclarations*>(client_data);
+  switch (clang_getCursorKind(cursor)) {
+    case CXCursor_Namespace:
+    case CXCursor_LinkageSpec:
+      return CXChildVisit_Recurse;
+    case CXCursor_ClassDecl:
+    case CXCursor_StructDecl:
+      if (IsMarked(cursor, *data->offsets)) {
+        ExtractClassInfo(cursor, *data->classInfos);
+      }
+      // 继续查找嵌套的类和枚举
+      return CXChildVisit_Recurse;
+    case CXCursor_EnumDecl:
+      if (IsMarked(cursor, *data->offsets)) {
+        ExtractEnumInfo(cursor, *data->enumInfos);
+      }
+      return CXChildVisit_Continue;
+    default:
+      return CXChildVisit_Continue;
+  }
+}
+
+void ExtractFromMacroExpansions(CXTranslationUnit tu,
+                                const std::vector<std::string>& registerMacros,
+                                std::vector<RTTRMarkClassInfo>& classInfos,
+                                std::vector<RTTRMarkEnumInfo>& enumInfos) {
+  std::unordered_set<std::string> macros(registerMacros.begin(), registerMacros.end());
+  MacroMarkers markers;
+  markers.registerMacros = &macros;
+  CXCursor tuCursor = clang_getTranslationUnitCursor(tu);
+  clang_visitChildren(tuCursor, VisitMacroExpansion, &markers);
+  if (markers.offsets.empty()) {
+    return;
+  }
+  std::sort(markers.offsets.begin(), markers.offsets.end());
+
+  MarkedDeclarations data = {&markers.offsets, &classInfos, &enumInfos};
+  clang_visitChildren(tuCursor, VisitDeclaration, &data);
+}
+
+}  // namespace Register
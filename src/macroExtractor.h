@@ -0,0 +1,37 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "register.h"
+
+namespace Register {
+
+// Finds the marked classes and enums of the main file from the macro expansions recorded by the
+// preprocessor, without tokenizing the whole file. A class or enum is marked when one of
+// registerMacros expands between the start of its declaration and its name, e.g.
+// "class RTTR_AUTO_REGISTER_CLASS Name". The translation unit must be parsed with
+// CXTranslationUnit_DetailedPreprocessingRecord.
+void ExtractFromMacroExpansions(CXTranslationUnit tu,
+                                const std::vector<std::string>& registerMacros,
+                                std::vector<RTTRMarkClassInfo>& classInfos,
+                                std::vector<RTTRMarkEnumInfo>& enumInfos);
+
+}  // namespace Register
@@ -20,10 +20,23 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <set>
 #include <string>
 #include <vector>
 #include "CLI11.hpp"
+#include "annotationExtractor.h"
+#include "declarationIndex.h"
+#include "depfile.h"
+#include "headerProcessor.h"
+#include "markerPrefilter.h"
+#include "memoryBudget.h"
+#include "perHeaderOutput.h"
+#include "precompiledHeader.h"
+#include "watchMode.h"
 #include "register.h"
+#include "shardMerge.h"
+#include "streamingPipeline.h"
+#include "shardedOutput.h"
 
 namespace fs = std::filesystem;
 
@@ -33,14 +46,61 @@ void GenerateHeaderFiles(std::vector<std::string> searchPaths,
     Register::GetHeaderFiles(searchPath, headFiles);
   }
 }
-void SetArgs(std::vector<std::string> includePaths, std::vector<const char*>& args) {
-  static std::vector<std::string> tempStrings;
-  tempStrings.clear();
+void SetArgs(const std::vector<std::string>& includePaths, std::vector<std::string>& args) {
   for (auto& token : includePaths) {
-    tempStrings.emplace_back(std::string("-I") + token);
-    args.push_back(tempStrings.back().c_str());
+    args.emplace_back(std::string("-I") + token);
   }
 }
+struct OutputOptions {
+  fs::path outputFile;
+  // "auto", a shard count, or empty for a single output file.
+  std::string shards;
+  // Directory for one generated file per header, empty for a single output file.
+  fs::path perHeaderDir;
+};
+bool WriteGeneratedCode(const std::vector<std::string>& headFiles,
+                        const std::vector<Register::HeaderParseResult>& header_results,
+                        const OutputOptions& output) {
+  const fs::path& output_file = output.outputFile;
+  const std::string& shards = output.shards;
+  if (!output.perHeaderDir.empty()) {
+    return Register::GeneratePerHeaderCode(headFiles, header_results, output.perHeaderDir);
+  }
+  if (!shards.empty()) {
+    size_t numTypes = 0;
+    for (const auto& result : header_results) {
+      numTypes += result.classInfos.size() + result.enumInfos.size();
+    }
+    unsigned shardCount = shards == "auto" ? Register::GetAutoShardCount(numTypes)
+                                           : static_cast<unsigned>(std::stoul(shards));
+    return Register::GenerateShardedCode(headFiles, header_results, output_file, shardCount);
+  }
+  std::vector<Register::RTTRMarkClassInfo> class_result;
+  std::vector<Register::RTTRMarkEnumInfo> enum_result;
+  std::vector<std::string> parse_file_rel_path;
+
+  // 只包含定义了注册类型及其属性类型的头文件, 按输入顺序排列
+  Register::DeclarationIndex declarationIndex(headFiles, header_results);
+  std::set<size_t> requiredHeaders;
+
+  // 按输入顺序合并结果, 保证输出与串行执行一致
+  for (size_t i = 0; i < headFiles.size(); ++i) {
+    auto& current = header_results[i];
+    declarationIndex.CollectRequiredHeaders(current, i, requiredHeaders);
+    class_result.insert(class_result.end(), current.classInfos.begin(), current.classInfos.end());
+    enum_result.insert(enum_result.end(), current.enumInfos.begin(), current.enumInfos.end());
+  }
+  declarationIndex.RemoveIncludedHeaders(requiredHeaders);
+  for (size_t i : requiredHeaders) {
+    // 计算相对路径
+    fs::path relative_path = fs::relative(headFiles[i], output_file.parent_path());
+    parse_file_rel_path.push_back(relative_path.string());
+  }
+
+  // 生成代码
+  return Register::GenerateCPPCode(class_result, enum_result, output_file.string(),
+                                   parse_file_rel_path);
+}
 int main(int argc, char** argv) {
   CLI::App app{"RTTR AUTO REGISTER"};
 
@@ -49,13 +109,12 @@ int main(int argc, char** argv) {
       "header files(end with .h or .hpp) that need to register RTTR";
   std::vector<std::string> searchPaths;
   app.add_option("-s,--search", searchPaths, description)
-      ->required()
       ->check(CLI::ExistingPath)
       ->take_all();
 
   description = "Specify the absolute path of generated header file";
   std::string outputFile;
-  app.add_option("-o,--output", outputFile, description)->required();
+  auto outputOption = app.add_option("-o,--output", outputFile, description);
 
   description =
       "Specify the absolute paths of the files included in the "
@@ -82,7 +141,178 @@ int main(int argc, char** argv) {
   description += "https://github.com/libpag/rttr-auto-register/tree/main/README.md";
   app.add_option("-m,--macro", registerMacros, description)->take_all();
 
+  description = "Specify the number of headers parsed concurrently, 0 means one per CPU core";
+  unsigned jobs = 1;
+  app.add_option("-j,--jobs", jobs, description);
+
+  description =
+      "Parse the headers in forked worker processes instead of threads, so a header that crashes "
+      "libclang only takes down its worker. The header is retried once and the others keep "
+      "going. Uses --jobs processes";
+  bool isolate = false;
+  app.add_flag("--isolate", isolate, description);
+
+  description =
+      "With --isolate, kill a worker process that spends more than this many seconds on one "
+      "header and treat it as crashed. 0 means no limit";
+  unsigned workerTimeout = 0;
+  app.add_option("--worker-timeout", workerTimeout, description);
+
+  description =
+      "Specify how headers are parsed: 'full' parses everything, 'fast' skips function bodies "
+      "and tolerates errors, 'compare' runs both and reports timings and result differences";
+  std::string parseMode = "full";
+  app.add_option("--parse-mode", parseMode, description)
+      ->check(CLI::IsMember({"full", "fast", "compare"}));
+
+  description =
+      "Specify how marked classes are found: 'tokens' scans the annotated tokens of each header, "
+      "'macros' visits the macro expansions recorded by the preprocessor and avoids tokenizing "
+      "whole headers, 'annotations' defines the markers as annotation attributes and walks the "
+      "AST once without tokenizing at all. Umbrella translation units always use 'tokens'";
+  std::string extraction = "tokens";
+  app.add_option("--extraction", extraction, description)
+      ->check(CLI::IsMember({"tokens", "macros", "annotations"}));
+
+  description =
+      "Specify a prefix header with the includes shared by all headers, e.g. std headers. It is "
+      "compiled once into a precompiled header that every header is parsed with";
+  std::string pchPrefix;
+  app.add_option("--pch-prefix", pchPrefix, description)->check(CLI::ExistingFile);
+
+  description =
+      "Specify where the precompiled header is written, defaults to the output file path with "
+      "a .pch suffix, or rttr.pch in the per-header output directory. It is reused by later "
+      "runs while its inputs are unchanged";
+  std::string pchOutput;
+  app.add_option("--pch-output", pchOutput, description);
+
+  description =
+      "Parse all headers in one umbrella translation unit that includes them all, so shared "
+      "includes are parsed once. Headers with errors in the umbrella are parsed on their own";
+  bool umbrella = false;
+  auto umbrellaOption = app.add_flag("--umbrella", umbrella, description);
+
+  description =
+      "Specify a directory for caching extraction results. A header is served from the cache "
+      "while its contents, the arguments, the macros and all files it includes are unchanged";
+  std::string cacheDir;
+  app.add_option("--cache-dir", cacheDir, description);
+
+  description =
+      "Keep running after the first generation, and regenerate the output whenever a header or "
+      "a file it includes changes. Only the affected headers are reparsed. The umbrella and "
+      "cache options are ignored in this mode";
+  bool watch = false;
+  auto watchOption = app.add_flag("--watch", watch, description);
+
+  description =
+      "Parse each header without its includes first, and only parse it with its includes if a "
+      "marked class has fields whose types are declared elsewhere. Much faster for headers that "
+      "mostly mark enums and plain structs. The umbrella option is ignored in this mode";
+  bool syntactic = false;
+  app.add_flag("--syntactic", syntactic, description);
+
+  description =
+      "Split the generated code into N .cpp shards that can be compiled in parallel, or 'auto' "
+      "to pick N from the number of registered types. Shard K is written next to the output "
+      "file as <stem>_shard<K>.cpp and the output file calls every shard from one "
+      "RTTR_REGISTRATION block, so it should be given a .cpp path and compiled once";
+  std::string shards;
+  auto shardsOption = app.add_option("--shards", shards, description)
+                          ->check(CLI::IsMember({"auto"}) | CLI::Range(1u, 4096u));
+
+  description =
+      "Write one .rttr.cpp file per header that registers a class or enum into this directory "
+      "instead of a single output file, plus a rttr_manifest.txt listing them. Files whose "
+      "contents did not change are not rewritten, so editing one header recompiles one file";
+  std::string perHeaderOutput;
+  auto perHeaderOption = app.add_option("--per-header-output", perHeaderOutput, description);
+  perHeaderOption->excludes(shardsOption);
+  outputOption->excludes(perHeaderOption);
+
+  description =
+      "Write a Make/Ninja depfile listing every searched header and every file included by the "
+      "parsed headers, for use with add_custom_command(DEPFILE ...)";
+  std::string depfile;
+  app.add_option("--depfile", depfile, description);
+
+  description =
+      "Touch this file after every successful run and use it as the depfile target, so that "
+      "build systems without restat do not rerun the command when the output is unchanged";
+  std::string stampFile;
+  app.add_option("--stamp", stampFile, description);
+
+  description =
+      "Specify a file that records how long each header took to parse. Later parallel runs start "
+      "the most expensive headers first; headers without history are ordered by size and number "
+      "of includes. Defaults to parse-stats in the cache directory when --cache-dir is given";
+  std::string statsFile;
+  app.add_option("--stats-file", statsFile, description);
+
+  description =
+      "Limit the memory of the translation units parsed at the same time, e.g. 8G or 512M. A "
+      "header only starts once its expected memory, taken from the stats file or from the "
+      "largest translation unit seen so far, fits next to those in flight";
+  std::string maxMemory;
+  app.add_option("--max-memory", maxMemory, description)
+      ->check(CLI::Validator(
+          [](std::string& value) {
+            uint64_t bytes = 0;
+            return Register::ParseMemorySize(value, bytes) ? std::string()
+                                                           : "expected a size like 512M or 8G";
+          },
+          "SIZE"));
+
+  description = "Parse every header, even those that contain no registration macros";
+  bool noPrefilter = false;
+  app.add_flag("--no-prefilter", noPrefilter, description);
+
+  description =
+      "Process only shard K of N (zero-based, e.g. 2/8) of the discovered headers, sorted by "
+      "path, and write their results to the output file instead of generated code. Combine the "
+      "results of all shards with the merge subcommand";
+  std::string shard;
+  auto shardOption = app.add_option("--shard", shard, description)
+      ->check(CLI::Validator(
+          [](std::string& value) {
+            Register::ShardSpec spec;
+            return Register::ShardSpecFromString(value, spec) ? std::string()
+                                                              : "expected K/N with K < N";
+          },
+          "K/N"))
+      ->excludes(perHeaderOption)
+      ->excludes(shardsOption);
+
+  description =
+      "Find, prefilter and parse headers in concurrent stages connected by bounded queues, so "
+      "parsing starts with the first header found instead of after the whole directory walk. "
+      "The output is the same as without streaming";
+  bool stream = false;
+  app.add_flag("--stream", stream, description)
+      ->excludes(umbrellaOption)
+      ->excludes(watchOption)
+      ->excludes(shardOption);
+
+  auto mergeCommand = app.add_subcommand(
+      "merge",
+      "Combine the result files of all --shard runs into the generated code. Classes and enums "
+      "registered by several headers are kept once and conflicting definitions are reported. "
+      "The output options are given before the subcommand");
+  std::vector<std::string> shardFiles;
+  mergeCommand->add_option("files", shardFiles, "The result files of all shards")
+      ->required()
+      ->check(CLI::ExistingFile);
+
   CLI11_PARSE(app, argc, argv);
+  if (searchPaths.empty() && !mergeCommand->parsed()) {
+    std::cerr << "Error: --search is required\n";
+    return 1;
+  }
+  if (outputFile.empty() && perHeaderOutput.empty()) {
+    std::cerr << "Error: --output or --per-header-output is required\n";
+    return 1;
+  }
 
   registerMacros.emplace_back("RTTR_AUTO_REGISTER_CLASS");
   std::sort(registerMacros.begin(), registerMacros.end());
@@ -90,57 +320,186 @@ int main(int argc, char** argv) {
   registerMacros.erase(last, registerMacros.end());
 
   // 获取输出文件路径
-  fs::path output_file = fs::absolute(outputFile);
-
-  std::vector<std::string> headFiles;
-  GenerateHeaderFiles(searchPaths, headFiles);
+  OutputOptions output;
+  output.shards = shards;
+  if (!perHeaderOutput.empty()) {
+    output.perHeaderDir = fs::absolute(perHeaderOutput);
+    output.outputFile = output.perHeaderDir / Register::PerHeaderManifestName;
+  } else {
+    output.outputFile = fs::absolute(outputFile);
+  }
+  const fs::path& output_file = output.outputFile;
+  // 输出内容不变时不会改写, 有时间戳文件时以它作为依赖文件的目标
+  fs::path depfileTarget = stampFile.empty() ? output_file : fs::path(stampFile);
 
-  try {
-    // 初始化 Clang
-    Register::ClangIndex index;
-    if (!index) {
-      std::cerr << "Failed to create Clang index\n";
+  if (mergeCommand->parsed()) {
+    std::vector<std::string> headFiles;
+    std::vector<Register::HeaderParseResult> header_results;
+    if (!Register::MergeShardResults(shardFiles, headFiles, header_results)) {
+      return 1;
+    }
+    if (!WriteGeneratedCode(headFiles, header_results, output)) {
       return 1;
     }
+    if (!depfile.empty()) {
+      std::vector<std::string> inputFiles = shardFiles;
+      inputFiles.insert(inputFiles.end(), headFiles.begin(), headFiles.end());
+      auto dependencies = Register::CollectDependencies(inputFiles, header_results);
+      if (!Register::WriteDepfile(fs::absolute(depfile), depfileTarget, dependencies)) {
+        return 1;
+      }
+    }
+    if (!stampFile.empty() && !Register::TouchStampFile(stampFile)) {
+      return 1;
+    }
+    std::cout << "Merged " << shardFiles.size() << " shard(s) into " << output_file << "\n";
+    return 0;
+  }
 
-    std::vector<const char*> args = {"-DTGFX_ENABLE_PROFILING", "-x", "c++", "-std=c++17"};
-    SetArgs(includePaths, args);
+  // 预过滤之前的全部头文件, 添加注册宏后它们也会影响输出
+  std::vector<std::string> searchedHeaders;
+  auto discoverHeaderFiles = [&]() {
+    std::vector<std::string> headFiles;
+    GenerateHeaderFiles(searchPaths, headFiles);
+    searchedHeaders = headFiles;
 
-    std::vector<Register::RTTRMarkClassInfo> class_result;
-    std::vector<Register::RTTRMarkEnumInfo> enum_result;
-    std::vector<std::string> parse_file_rel_path;
-    std::unordered_map<std::string, std::string> def_header_file;
+    // 跳过不包含任何注册宏的头文件, 避免无意义的 clang 解析
+    if (!noPrefilter) {
+      size_t total = headFiles.size();
+      size_t skipped =
+          Register::FilterMarkedHeaders(headFiles, Register::GetPrefilterMarkers(registerMacros));
+      std::cout << "Prefilter skipped " << skipped << " of " << total
+                << " headers without registration macros\n";
+    }
+    return headFiles;
+  };
 
-    for (const auto& header_file : headFiles) {
-      std::cout << "Process file : " << header_file << std::endl;
-      auto tu = Register::GetTranslationUnit(index, header_file, args);
+  try {
+    Register::ProcessOptions options;
+    options.args = {"-DTGFX_ENABLE_PROFILING", "-x", "c++", "-std=c++17"};
+    SetArgs(includePaths, options.args);
+    options.registerMacros = registerMacros;
+    options.jobs = jobs;
+    options.isolate = isolate;
+    options.workerTimeout = workerTimeout;
+    Register::ExtractionEngineFromString(extraction, options.extraction);
+    if (options.extraction == Register::ExtractionEngine::Annotations) {
+      auto defines = Register::GetAnnotationDefines(registerMacros);
+      options.args.insert(options.args.end(), defines.begin(), defines.end());
+    } else if (syntactic) {
+      auto defines = Register::GetSyntacticDefines(registerMacros);
+      options.args.insert(options.args.end(), defines.begin(), defines.end());
+    }
+    if (!pchPrefix.empty()) {
+      std::string pchFile = output_file.string() + ".pch";
+      if (!pchOutput.empty()) {
+        pchFile = pchOutput;
+      } else if (!output.perHeaderDir.empty()) {
+        pchFile = (output.perHeaderDir / "rttr.pch").string();
+      }
+      if (Register::PreparePrecompiledHeader(pchPrefix, pchFile, options.args)) {
+        options.args.emplace_back("-include-pch");
+        options.args.emplace_back(pchFile);
+      } else {
+        std::cerr << "Continue without precompiled header\n";
+      }
+    }
+    Register::ParseModeFromString(parseMode, options.parseMode);
+    options.umbrella = umbrella;
+    options.syntactic = syntactic;
+    options.cacheDir = cacheDir;
+    options.statsFile = statsFile;
+    if (!maxMemory.empty()) {
+      Register::ParseMemorySize(maxMemory, options.maxMemory);
+    }
+    if (statsFile.empty() && !cacheDir.empty()) {
+      options.statsFile = (fs::path(cacheDir) / "parse-stats").string();
+    }
+
+    if (watch) {
+      // 输出文件可能位于被监听的目录中
+      std::vector<std::string> outputPaths = {output_file.string()};
+      if (!output.perHeaderDir.empty()) {
+        outputPaths.push_back(output.perHeaderDir.string());
+      }
+      if (!output.shards.empty()) {
+        outputPaths.push_back((output_file.parent_path() / output_file.stem()).string() + "_shard");
+      }
+      return Register::RunWatchMode(
+          searchPaths, options, outputPaths, discoverHeaderFiles,
+          [&output](const std::vector<std::string>& headFiles,
+                    const std::vector<Register::HeaderParseResult>& results) {
+            if (WriteGeneratedCode(headFiles, results, output)) {
+              std::cout << "Generated code written to " << output.outputFile << std::endl;
+            }
+          });
+    }
 
-      if (!tu) {
-        std::cerr << "Failed to parse translation unit\n";
+    std::vector<std::string> headFiles;
+    std::vector<Register::HeaderParseResult> header_results;
+    Register::ShardSpec shardSpec;
+    std::vector<size_t> shardIndices;
+    if (stream) {
+      if (isolate) {
+        std::cerr << "Worker processes are not used with --stream, using threads\n";
+      }
+      Register::StreamingResult streamed;
+      bool success = Register::RunStreamingPipeline(searchPaths, options, !noPrefilter, streamed);
+      searchedHeaders = std::move(streamed.searchedHeaders);
+      headFiles = std::move(streamed.headFiles);
+      header_results = std::move(streamed.results);
+      if (!success) {
         return 1;
       }
-      // GetClassDefHeaderFileList(*tu, def_header_file);
-
-      auto tokenList = Register::GenerateTokenList(*tu);
-      std::vector<Register::RTTRMarkClassInfo> current_class_result;
-      std::vector<Register::RTTRMarkEnumInfo> current_enum_result;
-
-      Register::ParseRttrMarkClass(tokenList, registerMacros, current_class_result,
-                                   current_enum_result);
-
-      if (!current_class_result.empty() || !current_enum_result.empty()) {
-        // 计算相对路径
-        fs::path relative_path = fs::relative(header_file, output_file.parent_path());
-        parse_file_rel_path.push_back(relative_path.string());
-        class_result.insert(class_result.end(), current_class_result.begin(),
-                            current_class_result.end());
-        enum_result.insert(enum_result.end(), current_enum_result.begin(),
-                           current_enum_result.end());
+    } else {
+      headFiles = discoverHeaderFiles();
+    }
+    if (!shard.empty()) {
+      Register::ShardSpecFromString(shard, shardSpec);
+      size_t total = headFiles.size();
+      Register::SelectShard(shardSpec, headFiles, shardIndices);
+      std::cout << "Shard " << shard << " processes " << headFiles.size() << " of " << total
+                << " headers\n";
+    }
+
+    if (!stream && !Register::ProcessHeaderFiles(headFiles, options, header_results)) {
+      return 1;
+    }
+    if (options.parseMode == Register::ParseMode::Compare) {
+      Register::PrintParseModeComparison(headFiles, header_results);
+    }
+    if (!options.cacheDir.empty()) {
+      size_t hits = 0;
+      for (const auto& result : header_results) {
+        if (result.fromCache) {
+          hits++;
+        }
       }
+      std::cout << "Cache: " << hits << " hit(s), " << header_results.size() - hits
+                << " miss(es)\n";
     }
 
-    // 生成代码
-    Register::GenerateCPPCode(class_result, enum_result, output_file.string(), parse_file_rel_path);
+    if (!shard.empty()) {
+      if (!Register::WriteShardResults(output_file, shardSpec, headFiles, shardIndices,
+                                       header_results)) {
+        return 1;
+      }
+    } else if (!WriteGeneratedCode(headFiles, header_results, output)) {
+      return 1;
+    }
+    if (!depfile.empty()) {
+      std::vector<std::string> inputFiles = searchedHeaders;
+      if (!pchPrefix.empty()) {
+        inputFiles.push_back(pchPrefix);
+      }
+      auto dependencies = Register::CollectDependencies(inputFiles, header_results);
+      if (!Register::WriteDepfile(fs::absolute(depfile), depfileTarget, dependencies)) {
+        return 1;
+      }
+    }
+    if (!stampFile.empty() && !Register::TouchStampFile(stampFile)) {
+      return 1;
+    }
 
     // 输出成功信息
     std::cout << "Generated code written to " << output_file << "\n";
@@ -0,0 +1,88 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "markerPrefilter.h"
+#include <algorithm>
+#include <cstring>
+#include "mappedFile.h"
+
+namespace Register {
+
+MarkerScanner::MarkerScanner(const std::vector<std::string>& markers) {
+  for (const auto& marker : markers) {
+    if (marker.empty()) {
+      continue;
+    }
+    auto group = std::find_if(groups.begin(), groups.end(), [&marker](const MarkerGroup& g) {
+      return g.firstByte == marker.front();
+    });
+    if (group == groups.end()) {
+      groups.push_back({marker.front(), {marker}});
+    } else {
+      group->markers.push_back(marker);
+    }
+  }
+}
+
+bool MarkerScanner::Contains(const char* data, size_t size) const {
+  const char* end = data + size;
+  for (const auto& group : groups) {
+    const char* p = data;
+    while (p < end) {
+      p = static_cast<const char*>(memchr(p, group.firstByte, static_cast<size_t>(end - p)));
+      if (!p) {
+        break;
+      }
+      size_t remaining = static_cast<size_t>(end - p);
+      for (const auto& marker : group.markers) {
+        if (marker.size() <= remaining && memcmp(p, marker.data(), marker.size()) == 0) {
+          return true;
+        }
+      }
+      ++p;
+    }
+  }
+  return false;
+}
+
+bool MarkerScanner::FileContains(const std::string& path) const {
+  MappedFile file(path);
+  if (!file) {
+    return true;
+  }
+  return Contains(file.data(), file.size());
+}
+
+std::vector<std::string> GetPrefilterMarkers(const std::vector<std::string>& registerMacros) {
+  std::vector<std::string> markers = registerMacros;
+  markers.emplace_back("RTTR_REGISTER_FUNCTION_AS_PROPERTY");
+  return markers;
+}
+
+size_t FilterMarkedHeaders(std::vector<std::string>& headFiles,
+                           const std::vector<std::string>& markers) {
+  MarkerScanner scanner(markers);
+  size_t count = headFiles.size();
+  auto last = std::remove_if(headFiles.begin(), headFiles.end(), [&scanner](const std::string& f) {
+    return !scanner.FileContains(f);
+  });
+  headFiles.erase(last, headFiles.end());
+  return count - headFiles.size();
+}
+
+}  // namespace Register
@@ -0,0 +1,53 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Register {
+
+// Searches raw file bytes for any of a set of marker macros. Markers are grouped by their first
+// byte, and each group is located with memchr, which the C library vectorizes, before the full
+// marker is compared.
+class MarkerScanner {
+ public:
+  explicit MarkerScanner(const std::vector<std::string>& markers);
+
+  bool Contains(const char* data, size_t size) const;
+
+  bool FileContains(const std::string& path) const;
+
+ private:
+  struct MarkerGroup {
+    char firstByte;
+    std::vector<std::string> markers;
+  };
+  std::vector<MarkerGroup> groups;
+};
+
+// Returns the markers whose presence means a header may produce registrations.
+std::vector<std::string> GetPrefilterMarkers(const std::vector<std::string>& registerMacros);
+
+// Removes the headers that contain none of the markers, keeping the order of the rest. Headers
+// that cannot be read are kept so the parser reports them. Returns the number of removed headers.
+size_t FilterMarkedHeaders(std::vector<std::string>& headFiles,
+                           const std::vector<std::string>& markers);
+
+}  // namespace Register
@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "memoryBudget.h"
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <stdexcept>
+
+namespace Register {
+
+bool ParseMemorySize(const std::string& str, uint64_t& bytes) {
+  if (str.empty() || !std::isdigit(static_cast<unsigned char>(str.front()))) {
+    return false;
+  }
+  size_t end = 0;
+  uint64_t value = 0;
+  try {
+    value = std::stoull(str, &end);
+  } catch (const std::out_of_range&) {
+    return false;
+  }
+  std::string suffix = str.substr(end);
+  if (suffix.size() == 2 && (suffix[1] == 'B' || suffix[1] == 'b')) {
+    suffix.pop_back();
+  }
+  unsigned shift = 0;
+  if (suffix == "K" || suffix == "k") {
+    shift = 10;
+  } else if (suffix == "M" || suffix == "m") {
+    shift = 20;
+  } else if (suffix == "G" || suffix == "g") {
+    shift = 30;
+  } else if (!suffix.empty()) {
+    return false;
+  }
+  // 超出 64 位范围的大小视为无效
+  if (value > (std::numeric_limits<uint64_t>::max() >> shift)) {
+    return false;
+  }
+  bytes = value << shift;
+  return true;
+}
+
+uint64_t GetTranslationUnitMemory(CXTranslationUnit tu) {
+  CXTUResourceUsage usage = clang_getCXTUResourceUsage(tu);
+  uint64_t bytes = 0;
+  for (unsigned i = 0; i < usage.numEntries; ++i) {
+    const auto& entry = usage.entries[i];
+    if (entry.kind >= CXTUResourceUsage_MEMORY_IN_BYTES_BEGIN &&
+        entry.kind <= CXTUResourceUsage_MEMORY_IN_BYTES_END) {
+      bytes += entry.amount;
+    }
+  }
+  clang_disposeCXTUResourceUsage(usage);
+  return bytes;
+}
+
+bool MemoryBudget::Fits(uint64_t bytes) const {
+  return limit == 0 || inFlight == 0 || reserved + bytes <= limit;
+}
+
+void MemoryBudget::Acquire(uint64_t bytes) {
+  std::unique_lock<std::mutex> lock(mutex);
+  released.wait(lock, [&]() { return Fits(bytes); });
+  reserved += bytes;
+  inFlight++;
+}
+
+bool MemoryBudget::TryAcquire(uint64_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!Fits(bytes)) {
+    return false;
+  }
+  reserved += bytes;
+  inFlight++;
+  return true;
+}
+
+void MemoryBudget::Release(uint64_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    reserved -= std::min(reserved, bytes);
+    inFlight--;
+  }
+  released.notify_all();
+}
+
+void MemoryBudget::RecordMeasured(uint64_t bytes) {
+  uint64_t largest = largestMeasured.load();
+  while (bytes > largest && !largestMeasured.compare_exchange_weak(largest, bytes)) {
+  }
+}
+
+uint64_t MemoryBudget::GetUnknownEstimate() const {
+  uint64_t largest = largestMeasured.load();
+  return largest > 0 ? largest : DefaultTranslationUnitMemory;
+}
+
+}  // namespace Register
@@ -0,0 +1,79 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <clang-c/Index.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace Register {
+
+// Reserved for a header whose translation unit size is not known from history or from this run.
+constexpr uint64_t DefaultTranslationUnitMemory = 256ull << 20;
+
+// Parses a size such as "4096", "512M" or "8G" (K, M and G are powers of 1024). Returns false
+// for malformed sizes and sizes that do not fit in 64 bits.
+bool ParseMemorySize(const std::string& str, uint64_t& bytes);
+
+// Returns the memory held by a translation unit, as reported by clang_getCXTUResourceUsage().
+uint64_t GetTranslationUnitMemory(CXTranslationUnit tu);
+
+// Admission control for concurrent parses. A parse reserves the expected memory of its
+// translation unit before it starts and is admitted while all reservations fit in the limit.
+// A parse is always admitted when nothing else is in flight, so a header larger than the limit
+// still runs, on its own. A limit of 0 admits everything.
+class MemoryBudget {
+ public:
+  explicit MemoryBudget(uint64_t limit) : limit(limit) {
+  }
+
+  // Blocks until the reservation fits.
+  void Acquire(uint64_t bytes);
+
+  // Reserves and returns true if the reservation fits now.
+  bool TryAcquire(uint64_t bytes);
+
+  void Release(uint64_t bytes);
+
+  // Records the size of a translation unit measured in this run.
+  void RecordMeasured(uint64_t bytes);
+
+  // Returns the reservation for a header without history: the largest translation unit measured
+  // so far, or DefaultTranslationUnitMemory.
+  uint64_t GetUnknownEstimate() const;
+
+  bool enabled() const {
+    return limit > 0;
+  }
+
+ private:
+  uint64_t limit = 0;
+  uint64_t reserved = 0;
+  size_t inFlight = 0;
+  std::atomic<uint64_t> largestMeasured{0};
+  std::mutex mutex;
+  std::condition_variable released;
+
+  bool Fits(uint64_t bytes) const;
+};
+
+}  // namespace Register
@@ -0,0 +1,87 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "outputFile.h"
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include "contentHash.h"
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+static bool HasContents(const fs::path& path, const std::string& contents) {
+  std::error_code ec;
+  auto size = fs::file_size(path, ec);
+  if (ec || size != contents.size()) {
+    return false;
+  }
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open()) {
+    return false;
+  }
+  uint64_t hash = HashSeed;
+  char buffer[64 * 1024];
+  while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+    hash = HashBytes(buffer, static_cast<size_t>(in.gcount()), hash);
+  }
+  return hash == HashBytes(contents.data(), contents.size());
+}
+
+WriteStatus WriteFileIfChanged(const fs::path& path, const std::string& contents) {
+  if (HasContents(path, contents)) {
+    return WriteStatus::Unchanged;
+  }
+  std::error_code ec;
+  fs::path directory = path.parent_path();
+  if (!directory.empty() && !fs::exists(directory, ec) && !fs::create_directories(directory, ec)) {
+    std::cerr << "Error: Failed to create directory " << directory << std::endl;
+    return WriteStatus::Failed;
+  }
+
+  // 临时文件与目标在同一目录, 保证重命名是原子的; 随机后缀避免并发运行互相覆盖
+  std::ostringstream tempName;
+  tempName << path.string() << ".tmp" << std::hex << std::random_device()();
+  fs::path tempPath = tempName.str();
+  {
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+      std::cerr << "Error: Could not open file " << tempPath << " for writing" << std::endl;
+      return WriteStatus::Failed;
+    }
+    out << contents;
+    out.flush();
+    if (!out.good()) {
+      std::cerr << "Error: Failed to write file " << tempPath << std::endl;
+      out.close();
+      fs::remove(tempPath, ec);
+      return WriteStatus::Failed;
+    }
+  }
+  fs::rename(tempPath, path, ec);
+  if (ec) {
+    std::cerr << "Error: Failed to replace " << path << ": " << ec.message() << std::endl;
+    fs::remove(tempPath, ec);
+    return WriteStatus::Failed;
+  }
+  return WriteStatus::Written;
+}
+
+}  // namespace Register
@@ -0,0 +1,34 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+namespace Register {
+
+enum class WriteStatus { Unchanged, Written, Failed };
+
+// Replaces the file at path with contents, unless it already has the same size and content hash,
+// in which case the file and its modification time are left untouched. The contents are written
+// to a temporary file in the same directory first and renamed over path, so readers such as a
+// concurrent build never see a partially written file. Missing parent directories are created.
+WriteStatus WriteFileIfChanged(const std::filesystem::path& path, const std::string& contents);
+
+}  // namespace Register
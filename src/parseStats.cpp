@@ -0,0 +1,152 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "parseStats.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "mappedFile.h"
+#include "outputFile.h"
+#include "resultSerializer.h"
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+static constexpr const char* StatsVersion = "rttr-stats-2";
+// 每个 #include 大致相当于多少字节的头文件内容
+static constexpr double IncludeWeight = 16 * 1024;
+
+static std::string NormalizePath(const std::string& path) {
+  std::error_code ec;
+  fs::path absolutePath = fs::absolute(path, ec);
+  return (ec ? fs::path(path) : absolutePath).lexically_normal().string();
+}
+
+// Estimated cost of a header in arbitrary units, from its size and include fan-out.
+static double EstimateCost(const std::string& headerFile) {
+  MappedFile file(headerFile);
+  if (!file) {
+    return 0;
+  }
+  const char* data = file.data();
+  size_t size = file.size();
+  size_t includes = 0;
+  const char* end = data + size;
+  for (const char* p = data; p < end; ++p) {
+    p = static_cast<const char*>(memchr(p, '#', static_cast<size_t>(end - p)));
+    if (!p) {
+      break;
+    }
+    const char* directive = p + 1;
+    while (directive < end && (*directive == ' ' || *directive == '\t')) {
+      ++directive;
+    }
+    if (static_cast<size_t>(end - directive) >= 7 && memcmp(directive, "include", 7) == 0) {
+      includes++;
+    }
+  }
+  return static_cast<double>(size) + IncludeWeight * static_cast<double>(includes);
+}
+
+void ParseStats::Load(const std::string& path) {
+  headers.clear();
+  std::ifstream in(path, std::ios::binary);
+  std::string version;
+  size_t count = 0;
+  if (!in.is_open() || !ReadString(in, version) || version != StatsVersion || !(in >> count)) {
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    HeaderStats stats;
+    std::string headerFile;
+    if (!(in >> stats.milliseconds >> stats.memoryBytes) || !ReadString(in, headerFile)) {
+      headers.clear();
+      return;
+    }
+    headers[headerFile] = stats;
+  }
+}
+
+bool ParseStats::Save(const std::string& path) const {
+  // 按路径排序, 内容不变时不改写文件
+  std::vector<std::pair<std::string, HeaderStats>> entries;
+  std::error_code ec;
+  for (const auto& [headerFile, stats] : headers) {
+    if (fs::exists(headerFile, ec)) {
+      entries.emplace_back(headerFile, stats);
+    }
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+  std::ostringstream out;
+  WriteString(out, StatsVersion);
+  out << entries.size() << '\n';
+  for (const auto& [headerFile, stats] : entries) {
+    out << stats.milliseconds << ' ' << stats.memoryBytes << ' ';
+    WriteString(out, headerFile);
+  }
+  return WriteFileIfChanged(path, out.str()) != WriteStatus::Failed;
+}
+
+void ParseStats::Record(const std::string& headerFile, double time, uint64_t memoryBytes) {
+  auto result = headers.emplace(NormalizePath(headerFile), HeaderStats{time, memoryBytes});
+  if (!result.second) {
+    result.first->second.milliseconds = (result.first->second.milliseconds + time) / 2;
+    result.first->second.memoryBytes = memoryBytes;
+  }
+}
+
+uint64_t ParseStats::GetMemory(const std::string& headerFile) const {
+  auto iter = headers.find(NormalizePath(headerFile));
+  return iter != headers.end() ? iter->second.memoryBytes : 0;
+}
+
+std::vector<size_t> ParseStats::GetScheduleOrder(const std::vector<std::string>& headFiles) const {
+  std::vector<double> costs(headFiles.size(), -1);
+  std::vector<double> estimates(headFiles.size(), 0);
+  double knownTime = 0;
+  double knownEstimate = 0;
+  for (size_t i = 0; i < headFiles.size(); ++i) {
+    estimates[i] = EstimateCost(headFiles[i]);
+    auto iter = headers.find(NormalizePath(headFiles[i]));
+    if (iter != headers.end()) {
+      costs[i] = iter->second.milliseconds;
+      knownTime += iter->second.milliseconds;
+      knownEstimate += estimates[i];
+    }
+  }
+  // 用有历史记录的头文件换算估计值, 没有历史时只按估计值排序
+  double scale = knownEstimate > 0 ? knownTime / knownEstimate : 1;
+  for (size_t i = 0; i < headFiles.size(); ++i) {
+    if (costs[i] < 0) {
+      costs[i] = estimates[i] * scale;
+    }
+  }
+  std::vector<size_t> order(headFiles.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&costs](size_t a, size_t b) { return costs[a] > costs[b]; });
+  return order;
+}
+
+}  // namespace Register
@@ -0,0 +1,63 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Register {
+
+// Parse and extraction times and translation unit sizes of earlier runs, keyed by normalized
+// header path. Used to start the most expensive headers first, so that one large header
+// scheduled last does not decide the wall-clock time of a parallel run.
+class ParseStats {
+ public:
+  // Reads the stats file. A missing or invalid file leaves the stats empty.
+  void Load(const std::string& path);
+
+  // Writes the stats file, dropping headers that no longer exist.
+  bool Save(const std::string& path) const;
+
+  // Records the time one header took and the memory of its translation unit. The time is blended
+  // with the previous one to damp noise.
+  void Record(const std::string& headerFile, double milliseconds, uint64_t memoryBytes);
+
+  // Returns the recorded translation unit memory of the header, 0 if unknown.
+  uint64_t GetMemory(const std::string& headerFile) const;
+
+  // Returns the indices of headFiles by decreasing expected cost (longest processing time
+  // first). Headers without history are estimated from their size and number of #include lines,
+  // scaled by the time per estimated unit of the headers that do have history.
+  std::vector<size_t> GetScheduleOrder(const std::vector<std::string>& headFiles) const;
+
+  bool empty() const {
+    return headers.empty();
+  }
+
+ private:
+  struct HeaderStats {
+    double milliseconds = 0;
+    uint64_t memoryBytes = 0;
+  };
+  std::unordered_map<std::string, HeaderStats> headers;
+};
+
+}  // namespace Register
@@ -0,0 +1,109 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "perHeaderOutput.h"
+#include <cstdio>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include "contentHash.h"
+#include "declarationIndex.h"
+#include "outputFile.h"
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+static constexpr const char* PerHeaderSuffix = ".rttr.cpp";
+
+static std::string GetPerHeaderFileName(const std::string& headerFile, const fs::path& outputDir) {
+  std::string relativePath = fs::relative(headerFile, outputDir).generic_string();
+  char hash[9];
+  std::snprintf(hash, sizeof(hash), "%08x",
+                static_cast<unsigned>(HashString(relativePath) & 0xffffffffu));
+  return fs::path(headerFile).stem().string() + "_" + hash + PerHeaderSuffix;
+}
+
+bool GeneratePerHeaderCode(const std::vector<std::string>& headFiles,
+                           const std::vector<HeaderParseResult>& results,
+                           const fs::path& outputDir) {
+  std::error_code ec;
+  if (!fs::exists(outputDir) && !fs::create_directories(outputDir, ec)) {
+    std::cerr << "Error: Failed to create directory " << outputDir << std::endl;
+    return false;
+  }
+
+  DeclarationIndex declarationIndex(headFiles, results);
+  std::vector<std::string> generatedFiles;
+  size_t numWritten = 0;
+  for (size_t i = 0; i < headFiles.size() && i < results.size(); ++i) {
+    const auto& result = results[i];
+    if (result.classInfos.empty() && result.enumInfos.empty()) {
+      continue;
+    }
+    std::set<size_t> requiredHeaders;
+    declarationIndex.CollectRequiredHeaders(result, i, requiredHeaders);
+    declarationIndex.RemoveIncludedHeaders(requiredHeaders);
+
+    std::ostringstream f;
+    f << "// Auto-generated code for " << fs::path(headFiles[i]).filename().string() << "\n";
+    f << "#include <rttr/registration.h>\n";
+    for (size_t header : requiredHeaders) {
+      f << "#include \"" << fs::relative(headFiles[header], outputDir).string() << "\"\n";
+    }
+    f << "\n";
+    f << "RTTR_REGISTRATION\n";
+    f << "{\n";
+    f << "\tusing namespace rttr;\n\n";
+    WriteRegistrationCode(f, result.classInfos, result.enumInfos);
+    f << "}\n";
+
+    generatedFiles.push_back(GetPerHeaderFileName(headFiles[i], outputDir));
+    WriteStatus status = WriteFileIfChanged(outputDir / generatedFiles.back(), f.str());
+    if (status == WriteStatus::Failed) {
+      return false;
+    }
+    numWritten += status == WriteStatus::Written ? 1 : 0;
+  }
+
+  // 删除不再注册任何类型的头文件遗留的输出
+  std::set<std::string> generated(generatedFiles.begin(), generatedFiles.end());
+  std::string suffix = PerHeaderSuffix;
+  size_t numRemoved = 0;
+  for (const auto& entry : fs::directory_iterator(outputDir, ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.size() > suffix.size() &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0 &&
+        generated.count(name) == 0 && fs::remove(entry.path(), ec)) {
+      numRemoved++;
+    }
+  }
+
+  std::string manifest;
+  for (const auto& file : generatedFiles) {
+    manifest += file + "\n";
+  }
+  if (WriteFileIfChanged(outputDir / PerHeaderManifestName, manifest) == WriteStatus::Failed) {
+    return false;
+  }
+  std::cout << "Per-header output: " << numWritten << " written, "
+            << generatedFiles.size() - numWritten << " unchanged, " << numRemoved << " removed\n";
+  return true;
+}
+
+}  // namespace Register
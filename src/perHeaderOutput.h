@@ -0,0 +1,42 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+// Name of the manifest written into the per-header output directory.
+constexpr const char* PerHeaderManifestName = "rttr_manifest.txt";
+
+// Writes one <stem>_<hash>.rttr.cpp per header that registers a class or enum into outputDir.
+// Each file has its own RTTR_REGISTRATION block with that header's classes and enums, and
+// includes only the headers its types need. The hash is taken from the header path relative to
+// outputDir, so headers with the same name do not collide. The manifest lists the generated file
+// names, one per line, in input order. Files whose contents are unchanged are left untouched, and
+// .rttr.cpp files of headers that no longer register anything are removed. Returns false if a
+// file cannot be written.
+bool GeneratePerHeaderCode(const std::vector<std::string>& headFiles,
+                           const std::vector<HeaderParseResult>& results,
+                           const std::filesystem::path& outputDir);
+
+}  // namespace Register
@@ -0,0 +1,145 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "precompiledHeader.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include "contentHash.h"
+#include "headerProcessor.h"
+#include "register.h"
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+struct FileStamp {
+  uintmax_t size = 0;
+  int64_t modifyTime = 0;
+  std::string path;
+};
+
+static bool GetFileStamp(const std::string& path, FileStamp& stamp) {
+  std::error_code ec;
+  stamp.path = path;
+  stamp.size = fs::file_size(path, ec);
+  if (ec) {
+    return false;
+  }
+  auto time = fs::last_write_time(path, ec);
+  if (ec) {
+    return false;
+  }
+  stamp.modifyTime = static_cast<int64_t>(time.time_since_epoch().count());
+  return true;
+}
+
+static std::string GetStampPath(const std::string& pchFile) {
+  return pchFile + ".stamp";
+}
+
+static bool StampIsCurrent(const std::string& pchFile, uint64_t argsHash) {
+  if (!fs::exists(pchFile)) {
+    return false;
+  }
+  std::ifstream in(GetStampPath(pchFile));
+  std::string tag;
+  uint64_t hash = 0;
+  if (!(in >> tag >> hash) || tag != "args" || hash != argsHash) {
+    return false;
+  }
+  size_t count = 0;
+  while (in >> tag) {
+    FileStamp expected;
+    if (tag != "file" || !(in >> expected.size >> expected.modifyTime)) {
+      return false;
+    }
+    in.get();
+    std::getline(in, expected.path);
+    FileStamp actual;
+    if (!GetFileStamp(expected.path, actual) || actual.size != expected.size ||
+        actual.modifyTime != expected.modifyTime) {
+      return false;
+    }
+    count++;
+  }
+  return count > 0;
+}
+
+static bool WriteStamp(const std::string& pchFile, uint64_t argsHash,
+                       const std::vector<std::string>& files) {
+  std::ofstream out(GetStampPath(pchFile));
+  if (!out.is_open()) {
+    return false;
+  }
+  out << "args " << argsHash << "\n";
+  for (const auto& file : files) {
+    FileStamp stamp;
+    if (!GetFileStamp(file, stamp)) {
+      return false;
+    }
+    out << "file " << stamp.size << " " << stamp.modifyTime << " " << stamp.path << "\n";
+  }
+  return out.good();
+}
+
+bool PreparePrecompiledHeader(const std::string& prefixHeader, const std::string& pchFile,
+                              const std::vector<std::string>& args) {
+  uint64_t argsHash = HashString(fs::absolute(prefixHeader).string(), HashStrings(args));
+  if (StampIsCurrent(pchFile, argsHash)) {
+    std::cout << "Reuse precompiled header " << pchFile << std::endl;
+    return true;
+  }
+
+  // 前缀头文件需要按头文件编译, 其余参数与每个头文件的解析参数保持一致
+  std::vector<std::string> pchArgs = args;
+  for (size_t i = 0; i + 1 < pchArgs.size(); ++i) {
+    if (pchArgs[i] == "-x") {
+      pchArgs[i + 1] = "c++-header";
+    }
+  }
+
+  std::cout << "Build precompiled header " << pchFile << " from " << prefixHeader << std::endl;
+  ClangIndex index;
+  TranslationUnit tu(index, prefixHeader, GetArgPointers(pchArgs),
+                     CXTranslationUnit_ForSerialization | CXTranslationUnit_Incomplete);
+  if (!tu) {
+    std::cerr << "Failed to parse prefix header: " << prefixHeader << " (error code " << tu.error()
+              << ")" << std::endl;
+    return false;
+  }
+
+  fs::path pchDir = fs::path(pchFile).parent_path();
+  std::error_code ec;
+  if (!pchDir.empty()) {
+    fs::create_directories(pchDir, ec);
+  }
+  int error = clang_saveTranslationUnit(tu, pchFile.c_str(), clang_defaultSaveOptions(tu));
+  if (error != CXSaveError_None) {
+    std::cerr << "Failed to save precompiled header: " << pchFile << " (error code " << error
+              << ")" << std::endl;
+    return false;
+  }
+  if (!WriteStamp(pchFile, argsHash, GetIncludedFiles(tu))) {
+    // 没有有效的 stamp 只会导致下次重新生成
+    fs::remove(GetStampPath(pchFile), ec);
+  }
+  return true;
+}
+
+}  // namespace Register
@@ -0,0 +1,33 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Register {
+
+// Compiles prefixHeader into pchFile with the given compiler arguments. A stamp file next to
+// pchFile records the arguments and the size and modification time of every file the prefix
+// header includes; when none of them changed, the existing pchFile is reused without parsing.
+// Returns true if pchFile is ready to be passed with -include-pch.
+bool PreparePrecompiledHeader(const std::string& prefixHeader, const std::string& pchFile,
+                              const std::vector<std::string>& args);
+
+}  // namespace Register
@@ -20,152 +20,303 @@
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "register.h"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <optional>
 #include <sstream>
+#include <unordered_set>
 #include "clangraii/clangDiagnostic.h"
+#include "outputFile.h"
+#include "usrCache.h"
 
 namespace Register {
 
-static std::set<std::string> undefinedTypeList;
+bool operator==(const RTTRMarkClassInfo& lhs, const RTTRMarkClassInfo& rhs) {
+  return lhs.className == rhs.className && lhs.path == rhs.path &&
+         lhs.properties == rhs.properties && lhs.methods == rhs.methods && lhs.usr == rhs.usr &&
+         lhs.propertyTypeUSRs == rhs.propertyTypeUSRs;
+}
+
+bool operator==(const RTTRMarkEnumInfo& lhs, const RTTRMarkEnumInfo& rhs) {
+  return lhs.enumName == rhs.enumName && lhs.path == rhs.path && lhs.elements == rhs.elements &&
+         lhs.usr == rhs.usr;
+}
+
 std::shared_ptr<TranslationUnit> GetTranslationUnit(ClangIndex& index, const std::string& filepath,
-                                                    const std::vector<const char*>& args) {
-  std::shared_ptr<TranslationUnit> tu = std::make_shared<TranslationUnit>(index, filepath, args);
+                                                    const std::vector<const char*>& args,
+                                                    unsigned options) {
+  std::shared_ptr<TranslationUnit> tu =
+      std::make_shared<TranslationUnit>(index, filepath, args, options);
   if (!(*tu)) {
-    std::cerr << "Failed to parse file: " << filepath << std::endl;
+    std::cerr << "Failed to parse file: " << filepath << " (error code " << tu->error() << ")"
+              << std::endl;
     return nullptr;
   }
   // printDiagnostics(*tu);
   return tu;
 }
 
-std::string GetFullQualifiedName(CXCursor cursor) {
-  std::vector<std::string> parts;
+// Declaration USR -> qualified name of a namespace, class or struct.
+static UsrCache<std::string> qualifiedNames;
 
-  auto add_cursor_name = [&parts](CXCursor c) {
-    ClangString spelling(clang_getCursorSpelling(c));
-    std::string name = spelling.str();
-    if (!name.empty()) {
-      parts.push_back(name);
-    }
-  };
-
-  // 处理当前cursor
+static bool IsNamedScope(CXCursor cursor) {
   CXCursorKind kind = clang_getCursorKind(cursor);
-  if (kind == CXCursor_ClassDecl || kind == CXCursor_StructDecl || kind == CXCursor_EnumDecl) {
-    add_cursor_name(cursor);
+  if (kind != CXCursor_Namespace && kind != CXCursor_ClassDecl && kind != CXCursor_StructDecl) {
+    return false;
   }
+  // 匿名命名空间和匿名类不出现在限定名中; 内联命名空间保留, 带上它的名字同样合法
+  return !clang_Cursor_isAnonymous(cursor);
+}
 
-  // 处理父级
-  CXCursor parent = clang_getCursorSemanticParent(cursor);
-  while (!clang_Cursor_isNull(parent)) {
-    CXCursorKind parent_kind = clang_getCursorKind(parent);
-
-    if (parent_kind == CXCursor_Namespace || parent_kind == CXCursor_ClassDecl ||
-        parent_kind == CXCursor_StructDecl) {
+static std::string JoinQualifiedName(const std::string& scope, const std::string& name) {
+  if (scope.empty()) {
+    return name;
+  }
+  if (name.empty()) {
+    return scope;
+  }
+  return scope + "::" + name;
+}
 
-      ClangString parent_spelling(clang_getCursorSpelling(parent));
-      std::string name = parent_spelling.str();
-      if (!name.empty()) {
-        parts.insert(parts.begin(), name);
-      }
+// Returns the qualified name of the innermost named namespace or class that contains or is the
+// cursor. Scopes without a name of their own, e.g. extern "C" blocks, are skipped.
+static std::string GetScopeName(CXCursor cursor) {
+  while (!clang_Cursor_isNull(cursor) && !IsNamedScope(cursor)) {
+    if (clang_getCursorKind(cursor) == CXCursor_TranslationUnit) {
+      return "";
     }
-
-    parent = clang_getCursorSemanticParent(parent);
+    cursor = clang_getCursorSemanticParent(cursor);
   }
-
-  // 拼接结果
-  if (parts.empty()) {
+  if (clang_Cursor_isNull(cursor)) {
     return "";
   }
+  auto compute = [cursor]() {
+    ClangString spelling(clang_getCursorSpelling(cursor));
+    return JoinQualifiedName(GetScopeName(clang_getCursorSemanticParent(cursor)), spelling.str());
+  };
+  std::string usr = GetUSR(cursor);
+  if (usr.empty()) {
+    return compute();
+  }
+  // 每条命名空间和外层类的链只解析一次, 之后所有嵌套声明直接复用
+  return qualifiedNames.Get(usr, compute);
+}
 
-  std::string result;
-  for (size_t i = 0; i < parts.size(); ++i) {
-    if (i != 0) {
-      result += "::";
-    }
-    result += parts[i];
+std::string GetFullQualifiedName(CXCursor cursor) {
+  CXCursorKind kind = clang_getCursorKind(cursor);
+  if (kind == CXCursor_ClassDecl || kind == CXCursor_StructDecl) {
+    return GetScopeName(cursor);
   }
+  std::string scope = GetScopeName(clang_getCursorSemanticParent(cursor));
+  if (kind != CXCursor_EnumDecl || clang_Cursor_isAnonymous(cursor)) {
+    return scope;
+  }
+  ClangString spelling(clang_getCursorSpelling(cursor));
+  return JoinQualifiedName(scope, spelling.str());
+}
 
-  return result;
+// 按名称判断, 只用于无法解析出声明的类型
+static bool IsUnCopiedSpelling(CXType type) {
+  ClangString typeStr(clang_getTypeSpelling(type));
+  std::string str = typeStr.str();
+
+  // 检查类型名中是否包含"std::unique_ptr"或"unique_ptr"
+  bool isUniquePtr =
+      str.find("unique") != std::string::npos || str.find("Unique") != std::string::npos;
+  bool isMutex = str.find("mutex") != std::string::npos;
+  bool isAtomic = str.find("atomic") != std::string::npos;
+  bool isUnNamed = str.find("unname") != std::string::npos;
+  return isUniquePtr || isMutex || isAtomic || isUnNamed;
 }
 
-std::optional<CXCursor> FindNextMember(const std::vector<Token>& tokens, size_t startIndex,
-                                       CXCursorKind kind) {
-  for (size_t i = startIndex + 1; i < tokens.size(); ++i) {
-    const Token& token = tokens[i];
+// Record USR -> whether the record can be copied. Only records whose definition was visible are
+// cached, since that depends on the translation unit.
+static UsrCache<bool> copyableRecords;
+// Records whose copyability is being computed on this thread, to stop at recursive types.
+static thread_local std::unordered_set<std::string> copyabilityInProgress;
+// Number of live CopyabilityCacheBypass instances on this thread.
+static thread_local unsigned copyabilityCacheBypassDepth = 0;
 
-    if (token.isCommentOrPunctuation()) {
-      continue;
-    }
+CopyabilityCacheBypass::CopyabilityCacheBypass() {
+  copyabilityCacheBypassDepth++;
+}
+
+CopyabilityCacheBypass::~CopyabilityCacheBypass() {
+  copyabilityCacheBypassDepth--;
+}
 
-    CXCursor cursor = token.cursor;
-    while (!clang_Cursor_isNull(cursor)) {
-      if (clang_getCursorKind(cursor) == kind) {
-        return cursor;
+static std::optional<bool> IsUnCopiedResolvedType(CXType type);
+
+struct CopyMembers {
+  bool hasCopyConstructor = false;
+  bool copyConstructorUsable = true;
+  bool copyConstructorDefaulted = false;
+  bool hasMoveOperation = false;
+  bool hasUnCopiedMember = false;
+  // A field or base that is an invalid declaration, e.g. of a type that a
+  // CXTranslationUnit_SingleFileParse unit cannot resolve, or whose own copyability is unknown.
+  bool hasInvalidMember = false;
+  size_t numChildren = 0;
+};
+
+static CXChildVisitResult VisitCopyMember(CXCursor c, CXCursor parent, CXClientData data) {
+  auto members = static_cast<CopyMembers*>(data);
+  members->numChildren++;
+  switch (clang_getCursorKind(c)) {
+    case CXCursor_Constructor:
+      if (clang_CXXConstructor_isCopyConstructor(c)) {
+        members->hasCopyConstructor = true;
+        members->copyConstructorDefaulted = clang_CXXMethod_isDefaulted(c) != 0;
+        if (clang_CXXMethod_isDeleted(c) || clang_getCXXAccessSpecifier(c) != CX_CXXPublic) {
+          members->copyConstructorUsable = false;
+        }
+      } else if (clang_CXXConstructor_isMoveConstructor(c)) {
+        members->hasMoveOperation = true;
+      }
+      break;
+    case CXCursor_CXXMethod:
+      if (clang_CXXMethod_isMoveAssignmentOperator(c)) {
+        members->hasMoveOperation = true;
+      }
+      break;
+    case CXCursor_FieldDecl:
+    case CXCursor_CXXBaseSpecifier: {
+      // 无法解析的字段类型会退化为 int, 不能据此判断
+      if (clang_isInvalidDeclaration(c)) {
+        members->hasInvalidMember = true;
+        break;
       }
-      cursor = clang_getCursorSemanticParent(cursor);
+      CXType type = clang_getCursorType(c);
+      auto unCopied = IsUnCopiedResolvedType(type);
+      if (!unCopied && clang_getCanonicalType(type).kind == CXType_Record) {
+        members->hasInvalidMember = true;
+      } else if (unCopied.value_or(false)) {
+        members->hasUnCopiedMember = true;
+      }
+      break;
     }
+    default:
+      break;
   }
-  return std::nullopt;
+  return CXChildVisit_Continue;
 }
 
-std::vector<std::string> ProcessProperty(CXCursor cursor, const std::string& property_macro,
-                                         CXCursorKind kind) {
-  std::vector<std::string> result;
-
-  // 获取token范围
-  CXToken* tokens = nullptr;
-  unsigned num_tokens = 0;
-  CXSourceRange range = clang_getCursorExtent(cursor);
-  CXTranslationUnit tu = clang_Cursor_getTranslationUnit(cursor);
-  clang_tokenize(tu, range, &tokens, &num_tokens);
-
-  // 转换为Token结构体
-  std::vector<Token> token_list;
-  for (unsigned i = 0; i < num_tokens; ++i) {
-    CXToken token = tokens[i];
-    CXString spelling = clang_getTokenSpelling(tu, token);
-    CXCursor token_cursor;
-    clang_annotateTokens(tu, &token, 1, &token_cursor);
-
-    token_list.push_back({clang_getTokenKind(token), ClangString(spelling).str(), token_cursor});
+// Standard class templates whose copy constructor copies every element, so that they can only be
+// copied if their template arguments can. Smart pointers and other handles copy a pointer instead.
+static const std::unordered_set<std::string> valueContainerTemplates = {
+    "array", "deque", "forward_list", "list", "map", "multimap", "multiset", "optional", "pair",
+    "set", "tuple", "unordered_map", "unordered_multimap", "unordered_multiset", "unordered_set",
+    "variant", "vector"};
+
+// Returns true if the record is a specialization of one of valueContainerTemplates.
+static bool IsValueContainer(CXCursor definition) {
+  CXCursor pattern = clang_getSpecializedCursorTemplate(definition);
+  if (clang_Cursor_isNull(pattern)) {
+    return false;
   }
-  clang_disposeTokens(tu, tokens, num_tokens);
-
-  // 处理token
-  for (size_t i = 0; i < token_list.size(); ++i) {
-    const Token& token = token_list[i];
-
-    // 查找属性宏
-    if (token.isIdentifier(property_macro) && i + 1 < token_list.size()) {
-      // 查找下一个成员变量
-      auto member_cursor = FindNextMember(token_list, i, kind);
+  if (valueContainerTemplates.count(ClangString(clang_getCursorSpelling(pattern)).str()) == 0) {
+    return false;
+  }
+  // 取最外层的命名空间, 跳过 std::__1 等内联命名空间
+  std::string outermostNamespace;
+  CXCursor parent = clang_getCursorSemanticParent(pattern);
+  while (!clang_Cursor_isNull(parent) && !clang_isTranslationUnit(clang_getCursorKind(parent))) {
+    if (clang_getCursorKind(parent) == CXCursor_Namespace) {
+      outermostNamespace = ClangString(clang_getCursorSpelling(parent)).str();
+    }
+    parent = clang_getCursorSemanticParent(parent);
+  }
+  return outermostNamespace == "std";
+}
 
-      if (member_cursor) {
-        // 获取成员名称
-        CXString member_name = clang_getCursorSpelling(*member_cursor);
-        result.push_back(ClangString(member_name).str());
-      }
+// Returns whether the record can be copied, or nullopt if its definition is not visible in this
+// translation unit or it has invalid members.
+static std::optional<bool> IsCopyableRecord(CXType type, CXCursor declaration) {
+  CXCursor definition = clang_getCursorDefinition(declaration);
+  if (clang_Cursor_isNull(definition)) {
+    // 是否可见取决于翻译单元, 不能作为整个运行的结论
+    return std::nullopt;
+  }
+  CopyMembers members;
+  clang_visitChildren(definition, VisitCopyMember, &members);
+  CXCursor pattern = clang_getSpecializedCursorTemplate(definition);
+  if (members.numChildren == 0 && !clang_Cursor_isNull(pattern)) {
+    // 隐式实例化的模板特化没有可访问的成员, 检查模板本身
+    clang_visitChildren(pattern, VisitCopyMember, &members);
+  }
+  if (members.hasCopyConstructor && !members.copyConstructorUsable) {
+    return false;
+  }
+  if (members.hasInvalidMember) {
+    return std::nullopt;
+  }
+  if (!members.hasCopyConstructor && members.hasMoveOperation) {
+    // 声明了移动操作时隐式复制构造函数被删除
+    return false;
+  }
+  if ((!members.hasCopyConstructor || members.copyConstructorDefaulted) &&
+      members.hasUnCopiedMember) {
+    return false;
+  }
+  if (!IsValueContainer(definition)) {
+    return true;
+  }
+  // 容器的复制构造函数总是声明的, 但元素不可复制时无法实例化
+  int numArguments = clang_Type_getNumTemplateArguments(type);
+  for (int i = 0; i < numArguments; ++i) {
+    CXType argument = clang_Type_getTemplateArgumentAsType(type, static_cast<unsigned>(i));
+    if (argument.kind != CXType_Invalid && IsUnCopiedResolvedType(argument).value_or(false)) {
+      return false;
     }
   }
+  return true;
+}
 
-  return result;
+// Returns whether the type cannot be copied, or nullopt if its declaration cannot be resolved.
+static std::optional<bool> IsUnCopiedResolvedType(CXType type) {
+  type = clang_getCanonicalType(type);
+  // 数组的可复制性取决于元素类型
+  while (type.kind == CXType_ConstantArray || type.kind == CXType_IncompleteArray) {
+    type = clang_getCanonicalType(clang_getArrayElementType(type));
+  }
+  if (type.kind == CXType_Invalid || type.kind == CXType_Unexposed) {
+    return std::nullopt;
+  }
+  if (type.kind != CXType_Record) {
+    return false;
+  }
+  CXCursor declaration = clang_getTypeDeclaration(type);
+  if (clang_Cursor_isAnonymous(declaration)) {
+    // 匿名类型无法注册
+    return true;
+  }
+  std::string usr = GetUSR(declaration);
+  if (usr.empty()) {
+    return std::nullopt;
+  }
+  if (copyabilityInProgress.count(usr) > 0) {
+    return false;
+  }
+  bool useCache = copyabilityCacheBypassDepth == 0;
+  if (auto copyable = useCache ? copyableRecords.Find(usr) : std::nullopt) {
+    return !*copyable;
+  }
+  copyabilityInProgress.insert(usr);
+  std::optional<bool> copyable = IsCopyableRecord(type, declaration);
+  copyabilityInProgress.erase(usr);
+  if (!copyable) {
+    return std::nullopt;
+  }
+  if (useCache) {
+    copyableRecords.Insert(usr, *copyable);
+  }
+  return !*copyable;
 }
 
 bool isUnCopiedType(CXType type) {
-  ClangString typeStr(clang_getTypeSpelling(type));
-  std::string str = typeStr.str();
-  // std::cout << "type: " << str << std::endl;
-
-  // 检查类型名中是否包含"std::unique_ptr"或"unique_ptr"
-  bool isUniquePtr =
-      str.find("unique") != std::string::npos || str.find("Unique") != std::string::npos;
-  bool isMutex = str.find("mutex") != std::string::npos;
-  bool isAtomic = str.find("atomic") != std::string::npos;
-  bool isUnNamed = str.find("unname") != std::string::npos;
-  return isUniquePtr || isMutex || isAtomic || isUnNamed;
+  auto unCopied = IsUnCopiedResolvedType(type);
+  return unCopied ? *unCopied : IsUnCopiedSpelling(type);
 }
 
 CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData client_data) {
@@ -220,170 +371,261 @@ CXChildVisitResult visitor(CXCursor cursor, CXCursor parent, CXClientData client
   return CXChildVisit_Continue;
 }
 
-std::vector<Token> GenerateTokenList(TranslationUnit& tu) {
+TokenStream GenerateTokenStream(TranslationUnit& tu,
+                                const std::vector<std::string>& registerMacros) {
   // 获取翻译单元的游标
   CXCursor tu_cursor = clang_getTranslationUnitCursor(tu);
+  return GenerateTokenStream(tu, clang_getCursorExtent(tu_cursor), registerMacros);
+}
 
-  // 获取token范围
-  CXToken* tokens = nullptr;
-  unsigned num_tokens = 0;
-  CXSourceRange range = clang_getCursorExtent(tu_cursor);
-  clang_tokenize(tu, range, &tokens, &num_tokens);
-
-  // 转换为Token结构体
-  std::vector<Token> token_list;
-  for (unsigned i = 0; i < num_tokens; ++i) {
-    CXToken token = tokens[i];
-    CXString spelling = clang_getTokenSpelling(tu, token);
-    CXCursor token_cursor;
-    clang_annotateTokens(tu, &token, 1, &token_cursor);
+TokenStream GenerateTokenStream(TranslationUnit& tu, CXSourceRange range,
+                                const std::vector<std::string>& registerMacros) {
+  TokenStream tokens(registerMacros);
+  tokens.Tokenize(tu, range);
+  return tokens;
+}
 
-    token_list.push_back({clang_getTokenKind(token), ClangString(spelling).str(), token_cursor});
+bool ParseFunctionAsProperty(const TokenStream& tokens, size_t i,
+                             std::pair<std::string, std::string>& propertyFromFunction) {
+  if (tokens.marker(i) != MarkerKind::FunctionAsProperty) {
+    return false;
+  }
+  if (i != 0 && tokens.spelling(i - 1) == "define") {
+    return false;
+  }
+  if (i + 5 >= tokens.size()) {
+    return false;
+  }
+  if (tokens.spelling(i + 1) != "(" || tokens.spelling(i + 5) != ")") {
+    return false;
+  }
+  std::string_view propertyName = tokens.spelling(i + 2);
+  if (!propertyName.empty() && propertyName.front() == '"') {
+    propertyName.remove_prefix(1);
+  }
+  if (!propertyName.empty() && propertyName.back() == '"') {
+    propertyName.remove_suffix(1);
   }
-  clang_disposeTokens(tu, tokens, num_tokens);
-  return token_list;
+  propertyFromFunction = {std::string(propertyName), std::string(tokens.spelling(i + 4))};
+  return true;
 }
 
-void ParseRttrMarkClass(const std::vector<Token>& token_list,
-                        const std::vector<std::string>& registerMacros,
-                        std::vector<RTTRMarkClassInfo>& classInfos,
-                        std::vector<RTTRMarkEnumInfo>& enumInfos) {
-  std::vector<std::pair<std::string, std::string>> propertyFromFunctions;
-  for (size_t i = 0; i < token_list.size(); i++) {
-    const Token& token = token_list[i];
-    if (token.spelling == "RTTR_REGISTER_FUNCTION_AS_PROPERTY") {
-      if (i != 0) {
-        const Token& defineToken = token_list[i - 1];
-        if (defineToken.spelling == "define") {
-          continue;
+bool HasAnnotation(CXCursor cursor, const char* annotation) {
+  struct AnnotationData {
+    const char* annotation;
+    bool found;
+  } data = {annotation, false};
+  clang_visitChildren(
+      cursor,
+      [](CXCursor c, CXCursor parent, CXClientData client_data) {
+        if (clang_getCursorKind(c) != CXCursor_AnnotateAttr) {
+          return CXChildVisit_Continue;
         }
-      }
-      if (i + 5 < token_list.size()) {
-        const Token& leftParentheses = token_list[i + 1];
-        const Token& property = token_list[i + 2];
-        const Token& function = token_list[i + 4];
-        const Token& rightParentheses = token_list[i + 5];
-        if (leftParentheses.spelling != "(" || rightParentheses.spelling != ")") {
-          continue;
+        auto data = static_cast<AnnotationData*>(client_data);
+        ClangString spelling(clang_getCursorSpelling(c));
+        if (spelling.str() == data->annotation) {
+          data->found = true;
+          return CXChildVisit_Break;
         }
-        std::string propertyName = property.spelling;
-        if (!propertyName.empty()) {
-          if (propertyName.front() == '"') {
-            propertyName.erase(0, 1);
-          }
-          if (propertyName.back() == '"') {
-            propertyName.pop_back();
-          }
+        return CXChildVisit_Continue;
+      },
+      &data);
+  return data.found;
+}
+
+// Function name -> property names it is registered as, in declaration order.
+using PropertyFunctionMap = std::unordered_map<std::string, std::vector<std::string>>;
+
+static unsigned GetOffset(CXSourceLocation location) {
+  unsigned offset = 0;
+  clang_getFileLocation(location, nullptr, nullptr, nullptr, &offset);
+  return offset;
+}
+
+// Reads the property and function names from the message of the static_assert that
+// RTTR_REGISTER_FUNCTION_AS_PROPERTY expands to with annotated markers.
+static void ParsePropertyAssert(CXCursor cursor, PropertyFunctionMap& propertyFromFunctions) {
+  clang_visitChildren(
+      cursor,
+      [](CXCursor c, CXCursor parent, CXClientData client_data) {
+        if (clang_getCursorKind(c) != CXCursor_StringLiteral) {
+          return CXChildVisit_Continue;
+        }
+        CXEvalResult result = clang_Cursor_Evaluate(c);
+        if (!result) {
+          return CXChildVisit_Break;
+        }
+        std::string message;
+        if (clang_EvalResult_getKind(result) == CXEval_StrLiteral) {
+          message = clang_EvalResult_getAsStr(result);
         }
-        propertyFromFunctions.emplace_back(propertyName, function.spelling);
+        clang_EvalResult_dispose(result);
+        std::string prefix = PropertyAnnotationPrefix;
+        if (message.compare(0, prefix.size(), prefix) != 0) {
+          return CXChildVisit_Break;
+        }
+        message.erase(0, prefix.size());
+        size_t separator = message.find(':');
+        if (separator != std::string::npos) {
+          auto map = static_cast<PropertyFunctionMap*>(client_data);
+          (*map)[message.substr(separator + 1)].push_back(message.substr(0, separator));
+        }
+        return CXChildVisit_Break;
+      },
+      &propertyFromFunctions);
+}
+
+// Returns the USR of the class or enum a property of this type refers to, looking through
+// pointers, references and std containers. Empty for other types.
+static std::string GetTypeUSR(CXType type) {
+  CXType underlying = clang_getCanonicalType(getUnderlyingType(type));
+  if (underlying.kind != CXType_Record && underlying.kind != CXType_Enum) {
+    return "";
+  }
+  return GetUSR(clang_getTypeDeclaration(underlying));
+}
+
+void ExtractClassInfo(CXCursor cursor, std::vector<RTTRMarkClassInfo>& classInfos,
+                      bool annotatedMarkers) {
+  //获取类名
+  ClangString name(clang_getCursorSpelling(cursor));
+  // 获取完整限定名
+  std::string qualified_name = GetFullQualifiedName(cursor);
+
+  struct VisitorData {
+    bool annotatedMarkers;
+    // RTTR_SKIP_REGISTER_PROPERTY 的文件偏移, 升序
+    std::vector<unsigned> skipOffsets;
+    PropertyFunctionMap propertyFromFunctions;
+    std::vector<std::string> properties;
+    std::vector<std::string> propertyTypeUSRs;
+    // (method name, USR of the class or enum it returns)
+    std::vector<std::pair<std::string, std::string>> methods;
+  } visitorData;
+  visitorData.annotatedMarkers = annotatedMarkers;
+
+  if (!annotatedMarkers) {
+    // 整个类只分词一次, 同时收集跳过标记和函数属性映射
+    TokenStream tokens({});
+    tokens.Tokenize(clang_Cursor_getTranslationUnit(cursor), clang_getCursorExtent(cursor));
+    for (size_t i = 0; i < tokens.size(); ++i) {
+      if (tokens.marker(i) == MarkerKind::SkipProperty) {
+        visitorData.skipOffsets.push_back(tokens.offset(i));
+        continue;
+      }
+      std::pair<std::string, std::string> propertyFromFunction;
+      if (ParseFunctionAsProperty(tokens, i, propertyFromFunction)) {
+        visitorData.propertyFromFunctions[propertyFromFunction.second].push_back(
+            std::move(propertyFromFunction.first));
       }
     }
   }
 
-  for (size_t i = 0; i < token_list.size(); ++i) {
-    const Token& token = token_list[i];
-    bool identifierMatch = false;
-
-    for (const auto& macro : registerMacros) {
-      if (token.spelling == macro) {
-        identifierMatch = true;
-        break;
+  CXCursorVisitor visitfunc =
+      [](CXCursor c, CXCursor parent, CXClientData data) -> enum CXChildVisitResult {
+    auto visitorData = static_cast<VisitorData*>(data);
+    CXCursorKind kind = clang_getCursorKind(c);
+    if (kind == CXCursor_StaticAssert) {
+      if (visitorData->annotatedMarkers) {
+        ParsePropertyAssert(c, visitorData->propertyFromFunctions);
       }
+      return CXChildVisit_Continue;
     }
-    if (identifierMatch && (i + 1 < token_list.size())) {
-      CXCursor cursor = token_list[i + 1].cursor;
-      CXCursorKind kind = clang_getCursorKind(cursor);
-      if (kind == CXCursor_StructDecl || kind == CXCursor_ClassDecl) {
-        //获取类名
-        ClangString name(clang_getCursorSpelling(cursor));
-        // 获取完整限定名
-        std::string qualified_name = GetFullQualifiedName(cursor);
-
-        struct Elements {
-          std::vector<std::string> properties;
-          std::vector<std::string> methods;
-        } elements;
-
-        struct VisitorData {
-          Elements* elements;
-          const std::vector<std::pair<std::string, std::string>>& propertyFromFunctions;
-        };
-        VisitorData visitorData = {&elements, propertyFromFunctions};
-
-        CXCursorVisitor visitfunc =
-            [](CXCursor c, CXCursor parent, CXClientData data) -> enum CXChildVisitResult {
-          auto visitorData = static_cast<VisitorData*>(data);
-          auto elements = visitorData->elements;
-          const auto& propertyFromFunctions = visitorData->propertyFromFunctions;
-          CX_CXXAccessSpecifier access = clang_getCXXAccessSpecifier(c);
-          if (access == CX_CXXPrivate || access == CX_CXXProtected) {
-            return CXChildVisit_Continue;
-          }
-          if (clang_getCursorKind(c) == CXCursor_FieldDecl) {
-            CXSourceRange range = clang_getCursorExtent(c);
-            CXToken* tokens = nullptr;
-            unsigned numTokens = 0;
-            clang_tokenize(clang_Cursor_getTranslationUnit(c), range, &tokens, &numTokens);
-
-            bool skip = false;
-            for (unsigned i = 0; i < numTokens; ++i) {
-              ClangString tokenText(
-                  clang_getTokenSpelling(clang_Cursor_getTranslationUnit(c), tokens[i]));
-              if (tokenText.str() == "RTTR_SKIP_REGISTER_PROPERTY") {
-                skip = true;
-                break;
-              }
-            }
-            clang_disposeTokens(clang_Cursor_getTranslationUnit(c), tokens, numTokens);
-
-            if (skip) {
-              return CXChildVisit_Continue;
-            }
-            CXType memberType = clang_getCursorType(c);
-            if (!isUnCopiedType(memberType)) {
-              ClangString memberName(clang_getCursorSpelling(c));
-              elements->properties.push_back(memberName);
-            }
-          } else if (clang_getCursorKind(c) == CXCursor_CXXMethod) {
-            ClangString name(clang_getCursorSpelling(c));
-            std::string methName = name.str();
-            if (methName.find("RTTRAUTOMARK") != std::string::npos) {
-              elements->methods.push_back(methName);
-            } else {
-              for (const auto& pair : propertyFromFunctions) {
-                if (methName == pair.second) {
-                  elements->methods.push_back(pair.first + "|" + pair.second);
-                }
-              }
-            }
-          }
-          return CXChildVisit_Continue;
-        };
-
-        clang_visitChildren(cursor, visitfunc, &visitorData);
-        classInfos.push_back(
-            {name, qualified_name, std::move(elements.properties), std::move(elements.methods)});
-      } else if (kind == CXCursor_EnumDecl) {
-        // 获取枚举名
-        ClangString name(clang_getCursorSpelling(cursor));
-        // 获取完整限定名
-        std::string qualified_name = GetFullQualifiedName(cursor);
-        // 收集枚举常量
-        std::vector<std::string> elements;
-        // 遍历枚举的子节点
-        clang_visitChildren(
-            cursor,
-            [](CXCursor c, CXCursor parent, CXClientData client_data) {
-              if (clang_getCursorKind(c) == CXCursor_EnumConstantDecl) {
-                auto elements = static_cast<std::vector<std::string>*>(client_data);
-                ClangString spelling(clang_getCursorSpelling(c));
-                elements->push_back(spelling);
-              }
-              return CXChildVisit_Continue;
-            },
-            &elements);
-        enumInfos.push_back({name, qualified_name, std::move(elements)});
+    CX_CXXAccessSpecifier access = clang_getCXXAccessSpecifier(c);
+    if (access == CX_CXXPrivate || access == CX_CXXProtected) {
+      return CXChildVisit_Continue;
+    }
+    if (kind == CXCursor_FieldDecl) {
+      bool skip = false;
+      if (visitorData->annotatedMarkers) {
+        skip = HasAnnotation(c, SkipPropertyAnnotation);
+      } else if (!visitorData->skipOffsets.empty()) {
+        CXSourceRange range = clang_getCursorExtent(c);
+        const auto& offsets = visitorData->skipOffsets;
+        auto iter = std::lower_bound(offsets.begin(), offsets.end(),
+                                     GetOffset(clang_getRangeStart(range)));
+        skip = iter != offsets.end() && *iter < GetOffset(clang_getRangeEnd(range));
+      }
+      if (skip) {
+        return CXChildVisit_Continue;
+      }
+      CXType memberType = clang_getCursorType(c);
+      if (!isUnCopiedType(memberType)) {
+        ClangString memberName(clang_getCursorSpelling(c));
+        visitorData->properties.push_back(memberName);
+        visitorData->propertyTypeUSRs.push_back(GetTypeUSR(memberType));
       }
+    } else if (kind == CXCursor_CXXMethod) {
+      ClangString name(clang_getCursorSpelling(c));
+      CXType resultType = clang_getResultType(clang_getCursorType(c));
+      visitorData->methods.emplace_back(name, GetTypeUSR(resultType));
+    }
+    return CXChildVisit_Continue;
+  };
+  clang_visitChildren(cursor, visitfunc, &visitorData);
+
+  // 注解模式下映射可能声明在方法之后, 因此访问结束后再匹配
+  std::vector<std::string> methods;
+  auto& propertyTypeUSRs = visitorData.propertyTypeUSRs;
+  for (auto& [methName, resultUSR] : visitorData.methods) {
+    if (methName.find("RTTRAUTOMARK") != std::string::npos) {
+      methods.push_back(std::move(methName));
+      continue;
+    }
+    auto iter = visitorData.propertyFromFunctions.find(methName);
+    if (iter == visitorData.propertyFromFunctions.end()) {
+      continue;
+    }
+    for (const auto& propertyName : iter->second) {
+      methods.push_back(propertyName + "|" + methName);
+    }
+    propertyTypeUSRs.push_back(std::move(resultUSR));
+  }
+  // 去掉重复项和内置类型的空 USR
+  std::sort(propertyTypeUSRs.begin(), propertyTypeUSRs.end());
+  propertyTypeUSRs.erase(std::unique(propertyTypeUSRs.begin(), propertyTypeUSRs.end()),
+                         propertyTypeUSRs.end());
+  if (!propertyTypeUSRs.empty() && propertyTypeUSRs.front().empty()) {
+    propertyTypeUSRs.erase(propertyTypeUSRs.begin());
+  }
+  classInfos.push_back({name, qualified_name, std::move(visitorData.properties),
+                        std::move(methods), GetUSR(cursor), std::move(propertyTypeUSRs)});
+}
+
+void ExtractEnumInfo(CXCursor cursor, std::vector<RTTRMarkEnumInfo>& enumInfos) {
+  // 获取枚举名
+  ClangString name(clang_getCursorSpelling(cursor));
+  // 获取完整限定名
+  std::string qualified_name = GetFullQualifiedName(cursor);
+  // 收集枚举常量
+  std::vector<std::string> elements;
+  // 遍历枚举的子节点
+  clang_visitChildren(
+      cursor,
+      [](CXCursor c, CXCursor parent, CXClientData client_data) {
+        if (clang_getCursorKind(c) == CXCursor_EnumConstantDecl) {
+          auto elements = static_cast<std::vector<std::string>*>(client_data);
+          ClangString spelling(clang_getCursorSpelling(c));
+          elements->push_back(spelling);
+        }
+        return CXChildVisit_Continue;
+      },
+      &elements);
+  enumInfos.push_back({name, qualified_name, std::move(elements), GetUSR(cursor)});
+}
+
+void ParseRttrMarkClass(const TokenStream& tokens, std::vector<RTTRMarkClassInfo>& classInfos,
+                        std::vector<RTTRMarkEnumInfo>& enumInfos) {
+  for (size_t i = 0; i + 1 < tokens.size(); ++i) {
+    if (tokens.marker(i) != MarkerKind::Register) {
+      continue;
+    }
+    CXCursor cursor = tokens.cursor(i + 1);
+    CXCursorKind kind = clang_getCursorKind(cursor);
+    if (kind == CXCursor_StructDecl || kind == CXCursor_ClassDecl) {
+      ExtractClassInfo(cursor, classInfos);
+    } else if (kind == CXCursor_EnumDecl) {
+      ExtractEnumInfo(cursor, enumInfos);
     }
   }
 }
@@ -396,39 +638,8 @@ std::string removeRttrSuffix(std::string str) {
   return str;
 }
 
-void GenerateCPPCode(const std::vector<RTTRMarkClassInfo>& classInfos,
-                     const std::vector<RTTRMarkEnumInfo>& enumInfos, const std::string& outputFile,
-                     const std::vector<std::string>& relativePaths) {
-  std::filesystem::path outputPath(outputFile);
-  std::filesystem::path dirPath = outputPath.parent_path();
-
-  if (!dirPath.empty() && !std::filesystem::exists(dirPath)) {
-    if (!std::filesystem::create_directories(dirPath)) {
-      std::cerr << "Error: Failed to create directory " << dirPath << std::endl;
-      return;
-    }
-  }
-
-  std::ofstream f(outputFile);
-  if (!f.is_open()) {
-    std::cerr << "Error: Could not open file " << outputFile << " for writing" << std::endl;
-    return;
-  }
-
-  // 写入文件头
-  f << "// Auto-generated code\n";
-  f << "#pragma once\n";
-  f << "#include <rttr/registration.h>\n";
-  f << "#include <iostream>\n";
-  for (const std::string& relativePath : relativePaths) {
-    f << "#include \"" << relativePath << "\"\n";
-  }
-  f << "\n";
-  f << "RTTR_REGISTRATION\n";
-  f << "{\n";
-  f << "\tusing namespace rttr;\n\n";
-  f << "\tstd::cout << \"Rttr registed!\" << std::endl;\n\n";
-
+void WriteRegistrationCode(std::ostream& f, const std::vector<RTTRMarkClassInfo>& classInfos,
+                           const std::vector<RTTRMarkEnumInfo>& enumInfos) {
   // 生成类注册代码
   for (const auto& info : classInfos) {
     f << "\tregistration::class_<" << info.path << ">(\"" << info.className << "\")";
@@ -472,116 +683,169 @@ void GenerateCPPCode(const std::vector<RTTRMarkClassInfo>& classInfos,
     f << "\n     )";
     f << ";\n\n";
   }
+}
+
+bool GenerateCPPCode(const std::vector<RTTRMarkClassInfo>& classInfos,
+                     const std::vector<RTTRMarkEnumInfo>& enumInfos, const std::string& outputFile,
+                     const std::vector<std::string>& relativePaths) {
+  // 先在内存中生成, 内容不变时不改动输出文件
+  std::ostringstream f;
+  f << "// Auto-generated code\n";
+  f << "#pragma once\n";
+  f << "#include <rttr/registration.h>\n";
+  f << "#include <iostream>\n";
+  for (const std::string& relativePath : relativePaths) {
+    f << "#include \"" << relativePath << "\"\n";
+  }
+  f << "\n";
+  f << "RTTR_REGISTRATION\n";
+  f << "{\n";
+  f << "\tusing namespace rttr;\n\n";
+  f << "\tstd::cout << \"Rttr registed!\" << std::endl;\n\n";
+
+  WriteRegistrationCode(f, classInfos, enumInfos);
 
   f << "}\n";
-  f.close();
+  WriteStatus status = WriteFileIfChanged(outputFile, f.str());
+  if (status == WriteStatus::Unchanged) {
+    std::cout << "Generated code is unchanged: " << outputFile << std::endl;
+  }
+  return status != WriteStatus::Failed;
 }
 
 void GetHeaderFiles(const std::filesystem::path& dir, std::vector<std::string>& files) {
+  VisitHeaderFiles(dir, [&files](const std::string& file) {
+    files.push_back(file);
+    return true;
+  });
+}
+
+void VisitHeaderFiles(const std::filesystem::path& dir,
+                      const std::function<bool(const std::string&)>& visit) {
   if (!std::filesystem::is_directory(dir) && dir.string().find(".h") != std::string::npos) {
-    files.push_back(dir.string());
+    visit(dir.string());
     return;
   }
   for (const auto& entry : std::filesystem::recursive_directory_iterator(dir)) {
     if (entry.is_regular_file() && (entry.path().extension() == ".h" || entry.path().extension() == ".hpp")) {
-      files.push_back(entry.path().string());
+      if (!visit(entry.path().string())) {
+        return;
+      }
     }
   }
 }
 
-std::vector<std::string> splitBySemicolon(const std::string& str) {
-  std::vector<std::string> tokens;
-  std::stringstream ss(str);
-  std::string token;
-  while (std::getline(ss, token, ';')) {
-    if (!token.empty()) {  // 过滤空字符串
-      tokens.push_back(token);
-    }
+std::optional<CXSourceRange> GetFileRange(CXTranslationUnit tu, const std::string& filepath) {
+  CXFile file = clang_getFile(tu, filepath.c_str());
+  if (!file) {
+    return std::nullopt;
   }
-  return tokens;
-}
-
-void GetForwardDecl(TranslationUnit& tu,
-                    std::unordered_map<std::string, Register::ForwardDeclInfo>& map) {
-  if (!tu) {
-    return;
+  size_t size = 0;
+  if (!clang_getFileContents(tu, file, &size)) {
+    return std::nullopt;
   }
+  CXSourceLocation begin = clang_getLocationForOffset(tu, file, 0);
+  CXSourceLocation end = clang_getLocationForOffset(tu, file, static_cast<unsigned>(size));
+  return clang_getRange(begin, end);
+}
 
-  // 获取翻译单元的游标
-  CXCursor tu_cursor = clang_getTranslationUnitCursor(tu);
-  clang_visitChildren(
-      tu_cursor,
-      [](CXCursor cursor, CXCursor parent, CXClientData client_data) {
-        auto map =
-            static_cast<std::unordered_map<std::string, Register::ForwardDeclInfo>*>(client_data);
-        CXCursorKind kind = clang_getCursorKind(cursor);
-        // 判断是否为类或结构体的前向声明
-        if (kind == CXCursor_ClassDecl || kind == CXCursor_StructDecl) {
-          // 检查定义是否为空（判断是否为前向声明）
-          if (!clang_isCursorDefinition(cursor)) {
-            ClangString cursorName(clang_getCursorSpelling(cursor));
-            if (map->find(cursorName.str()) == map->end()) {
-              map->insert({cursorName.str(), {}});
-            }
-            std::cout << "forward class: " << cursorName.str() << std::endl;
-          }
-        }
-        return CXChildVisit_Recurse;
+std::vector<std::string> GetIncludedFiles(CXTranslationUnit tu) {
+  std::vector<std::string> files;
+  clang_getInclusions(
+      tu,
+      [](CXFile included_file, CXSourceLocation* inclusion_stack, unsigned include_len,
+         CXClientData client_data) {
+        auto files = static_cast<std::vector<std::string>*>(client_data);
+        ClangString filename(clang_getFileName(included_file));
+        files->push_back(filename.str());
       },
-      &map);
+      &files);
+  return files;
 }
 
-void GetClassDefHeaderFileList(TranslationUnit& tu,
-                               std::unordered_map<std::string, std::string>& DefList) {
-  if (!tu) {
-    return;
+struct DefinedTypesData {
+  bool mainFileOnly;
+  std::unordered_map<CXFile, std::vector<std::string>> types;
+};
+
+static CXChildVisitResult VisitDefinedType(CXCursor cursor, CXCursor parent,
+                                           CXClientData client_data) {
+  auto data = static_cast<DefinedTypesData*>(client_data);
+  CXSourceLocation location = clang_getCursorLocation(cursor);
+  if (data->mainFileOnly ? !clang_Location_isFromMainFile(location)
+                         : clang_Location_isInSystemHeader(location) != 0) {
+    return CXChildVisit_Continue;
   }
-  // 获取翻译单元的游标
-  CXCursor tu_cursor = clang_getTranslationUnitCursor(tu);
-  clang_visitChildren(
-      tu_cursor,
-      [](CXCursor cursor, CXCursor parent, CXClientData client_data) {
-        auto DefList = static_cast<std::unordered_map<std::string, std::string>*>(client_data);
-        CXCursorKind kind = clang_getCursorKind(cursor);
-        // 判断是否为类或结构体的前向声明
-        if (kind == CXCursor_ClassDecl || kind == CXCursor_StructDecl) {
-          // 检查定义是否为空（判断是否为前向声明）
-          if (clang_isCursorDefinition(cursor)) {
-            std::string qualified_name = GetFullQualifiedName(cursor);
-            if (DefList->find(qualified_name) == DefList->end()) {
-              CXFile file;
-              unsigned line, column, offset;
-              CXSourceLocation location = clang_getCursorLocation(cursor);
-              clang_getFileLocation(location, &file, &line, &column, &offset);
-              ClangString filepath(clang_getFileName(file));
-              DefList->at(qualified_name) = filepath.str();
-            }
-          }
+  CXCursorKind kind = clang_getCursorKind(cursor);
+  switch (kind) {
+    case CXCursor_Namespace:
+    case CXCursor_LinkageSpec:
+      return CXChildVisit_Recurse;
+    case CXCursor_ClassDecl:
+    case CXCursor_StructDecl:
+    case CXCursor_EnumDecl:
+      // 只记录定义, 前向声明不能决定包含哪个头文件
+      if (clang_isCursorDefinition(cursor)) {
+        CXFile file = nullptr;
+        clang_getFileLocation(location, &file, nullptr, nullptr, nullptr);
+        std::string usr = GetUSR(cursor);
+        if (file && !usr.empty()) {
+          data->types[file].push_back(std::move(usr));
         }
-        return CXChildVisit_Recurse;
-      },
-      &DefList);
+      }
+      return kind == CXCursor_EnumDecl ? CXChildVisit_Continue : CXChildVisit_Recurse;
+    default:
+      return CXChildVisit_Continue;
+  }
 }
 
-CXType getUnderlyingType(CXType type) {
-  if (clang_Type_getNumTemplateArguments(type) > 0) {
-    // 常见容器和智能指针检查
-    CXString typeName = clang_getTypeSpelling(type);
-    const char* name = clang_getCString(typeName);
+std::unordered_map<CXFile, std::vector<std::string>> GetDefinedTypes(CXTranslationUnit tu,
+                                                                   bool mainFileOnly) {
+  DefinedTypesData data = {mainFileOnly, {}};
+  clang_visitChildren(clang_getTranslationUnitCursor(tu), VisitDefinedType, &data);
+  return std::move(data.types);
+}
 
-    // 检查是否是标准库容器或智能指针
-    if (strstr(name, "std::vector") || strstr(name, "std::list") ||
-        strstr(name, "std::shared_ptr") || strstr(name, "std::unique_ptr") ||
-        strstr(name, "std::weak_ptr") || strstr(name, "std::optional")) {
+// Template USR -> whether it is a std container or smart pointer that getUnderlyingType() unwraps.
+static UsrCache<bool> wrapperTemplates;
 
+static bool IsWrapperTemplate(CXCursor pattern) {
+  static const std::unordered_set<std::string> wrappers = {
+      "vector", "list", "shared_ptr", "unique_ptr", "weak_ptr", "optional"};
+  ClangString name(clang_getCursorSpelling(pattern));
+  if (wrappers.count(name.str()) == 0) {
+    return false;
+  }
+  // 最外层命名空间必须是 std, 内联命名空间(如 __cxx11)可以出现在中间
+  CXCursor outermost = clang_getNullCursor();
+  for (CXCursor parent = clang_getCursorSemanticParent(pattern);
+       !clang_Cursor_isNull(parent) && clang_getCursorKind(parent) != CXCursor_TranslationUnit;
+       parent = clang_getCursorSemanticParent(parent)) {
+    outermost = parent;
+  }
+  return clang_getCursorKind(outermost) == CXCursor_Namespace &&
+         ClangString(clang_getCursorSpelling(outermost)).str() == "std";
+}
+
+void ResetTypeCaches() {
+  qualifiedNames.Clear();
+  copyableRecords.Clear();
+  wrapperTemplates.Clear();
+}
+
+CXType getUnderlyingType(CXType type) {
+  if (clang_Type_getNumTemplateArguments(type) > 0) {
+    // 常见容器和智能指针检查, 按模板声明而不是类型名称判断
+    CXCursor declaration = clang_getTypeDeclaration(clang_getCanonicalType(type));
+    CXCursor pattern = clang_getSpecializedCursorTemplate(declaration);
+    if (!clang_Cursor_isNull(pattern) &&
+        wrapperTemplates.Get(GetUSR(pattern), [&]() { return IsWrapperTemplate(pattern); })) {
       // 获取第一个模板参数
       CXType templateArg = clang_Type_getTemplateArgumentAsType(type, 0);
       if (templateArg.kind != CXType_Invalid) {
-        clang_disposeString(typeName);
         return getUnderlyingType(templateArg);  // 递归处理嵌套情况
       }
     }
-    clang_disposeString(typeName);
   }
 
   if (type.kind == CXType_Pointer || type.kind == CXType_LValueReference ||
@@ -605,7 +869,112 @@ bool typeIsDefined(CXType type) {
   return true;
 }
 
-void printDiagnostics(CXTranslationUnit translationUnit) {
+bool IsSelfContainedType(CXType type) {
+  type = clang_getCanonicalType(type);
+  while (true) {
+    CXType element = clang_getPointeeType(type);
+    if (element.kind == CXType_Invalid) {
+      element = clang_getArrayElementType(type);
+    }
+    if (element.kind == CXType_Invalid) {
+      break;
+    }
+    type = clang_getCanonicalType(element);
+  }
+  if (type.kind >= CXType_FirstBuiltin && type.kind <= CXType_LastBuiltin) {
+    return true;
+  }
+  if (type.kind == CXType_Record || type.kind == CXType_Enum) {
+    // 模板特化(如 std::vector<int>)的声明在包含文件中, 需要完整解析
+    CXCursor declaration = clang_getTypeDeclaration(type);
+    return clang_Location_isFromMainFile(clang_getCursorLocation(declaration)) != 0;
+  }
+  return false;
+}
+
+struct SemanticCheckData {
+  std::unordered_set<std::string> classNames;
+  bool needsSemanticParse = false;
+};
+
+static CXChildVisitResult VisitSemanticCheck(CXCursor cursor, CXCursor parent,
+                                             CXClientData client_data) {
+  if (!clang_Location_isFromMainFile(clang_getCursorLocation(cursor))) {
+    return CXChildVisit_Continue;
+  }
+  auto data = static_cast<SemanticCheckData*>(client_data);
+  CXCursorKind kind = clang_getCursorKind(cursor);
+  if (kind == CXCursor_Namespace || kind == CXCursor_LinkageSpec) {
+    return CXChildVisit_Recurse;
+  }
+  if (kind != CXCursor_ClassDecl && kind != CXCursor_StructDecl) {
+    return CXChildVisit_Continue;
+  }
+  if (data->classNames.count(GetFullQualifiedName(cursor)) > 0) {
+    clang_visitChildren(
+        cursor,
+        [](CXCursor c, CXCursor parent, CXClientData client_data) {
+          if (clang_getCursorKind(c) != CXCursor_FieldDecl) {
+            return CXChildVisit_Continue;
+          }
+          CX_CXXAccessSpecifier access = clang_getCXXAccessSpecifier(c);
+          if (access == CX_CXXPrivate || access == CX_CXXProtected) {
+            return CXChildVisit_Continue;
+          }
+          // 未知类型的字段会被标记为无效声明, 其类型退化为 int; 字段类型的成员也可能无效
+          CXType type = clang_getCursorType(c);
+          if (clang_isInvalidDeclaration(c) || !IsSelfContainedType(type) ||
+              !IsUnCopiedResolvedType(type)) {
+            *static_cast<bool*>(client_data) = true;
+            return CXChildVisit_Break;
+          }
+          return CXChildVisit_Continue;
+        },
+        &data->needsSemanticParse);
+    if (data->needsSemanticParse) {
+      return CXChildVisit_Break;
+    }
+  }
+  // 嵌套类也可能被标记
+  return CXChildVisit_Recurse;
+}
+
+bool NeedsSemanticParse(CXTranslationUnit tu, const std::vector<RTTRMarkClassInfo>& classInfos) {
+  if (classInfos.empty()) {
+    return false;
+  }
+  SemanticCheckData data;
+  for (const auto& classInfo : classInfos) {
+    data.classNames.insert(classInfo.path);
+  }
+  clang_visitChildren(clang_getTranslationUnitCursor(tu), VisitSemanticCheck, &data);
+  return data.needsSemanticParse;
+}
+
+bool HasMainFileErrors(CXTranslationUnit tu) {
+  unsigned numDiagnostics = clang_getNumDiagnostics(tu);
+  for (unsigned i = 0; i < numDiagnostics; ++i) {
+    ClangDiagnostic diagnostic(clang_getDiagnostic(tu, i));
+    if (clang_getDiagnosticSeverity(diagnostic) >= CXDiagnostic_Error &&
+        clang_Location_isFromMainFile(clang_getDiagnosticLocation(diagnostic))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t CountRegisterMarkers(TranslationUnit& tu, const std::vector<std::string>& registerMacros) {
+  TokenStream tokens = GenerateTokenStream(tu, registerMacros);
+  size_t count = 0;
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    if (tokens.kind(i) == CXToken_Identifier && tokens.marker(i) == MarkerKind::Register) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+bool printDiagnostics(CXTranslationUnit translationUnit) {
   int nbDiag = clang_getNumDiagnostics(translationUnit);
   printf("There are %i diagnostics:\n", nbDiag);
 
@@ -623,8 +992,8 @@ void printDiagnostics(CXTranslationUnit translationUnit) {
   }
   if (foundError) {
     std::cerr << "Please resolve these issues and try again." << std::endl;
-    exit(-1);
   }
+  return foundError;
 }
 
 }  // namespace Register
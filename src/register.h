@@ -24,12 +24,16 @@
 #include <clang-c/Index.h>
 #include <cstring>
 #include <filesystem>
+#include <functional>
 #include <optional>
+#include <ostream>
 #include <set>
 #include <unordered_map>
+#include <utility>
 #include "clangraii/clangIndex.h"
 #include "clangraii/clangString.h"
 #include "clangraii/translationUnit.h"
+#include "tokenStream.h"
 
 namespace Register {
 
@@ -38,67 +42,128 @@ struct RTTRMarkClassInfo {
   std::string path;
   std::vector<std::string> properties;
   std::vector<std::string> methods;
+  std::string usr;
+  // USRs of the classes and enums the registered properties refer to, see DeclarationIndex.
+  std::vector<std::string> propertyTypeUSRs;
 };
 
 struct RTTRMarkEnumInfo {
   std::string enumName;
   std::string path;
   std::vector<std::string> elements;
+  std::string usr;
 };
 
-struct ForwardDeclInfo {
-  bool isFoundDef = false;
-  std::string defFilePath;
-};
+bool operator==(const RTTRMarkClassInfo& lhs, const RTTRMarkClassInfo& rhs);
+bool operator==(const RTTRMarkEnumInfo& lhs, const RTTRMarkEnumInfo& rhs);
 
-// Token 结构体
-struct Token {
-  CXTokenKind kind;
-  std::string spelling;
-  CXCursor cursor;
+std::shared_ptr<TranslationUnit> GetTranslationUnit(ClangIndex& index, const std::string& filepath,
+                                                    const std::vector<const char*>& args,
+                                                    unsigned options = CXTranslationUnit_None);
 
-  bool isIdentifier(const std::string& id) const {
-    return kind == CXToken_Identifier && spelling == id;
-  }
+// Returns the name of a class, struct or enum qualified with its enclosing namespaces and classes,
+// e.g. "ns::Outer::Inner". Anonymous namespaces and classes are left out. Enclosing scopes are
+// resolved once per run and cached by USR.
+std::string GetFullQualifiedName(CXCursor cursor);
 
-  bool isCommentOrPunctuation() const {
-    return kind == CXToken_Comment || kind == CXToken_Punctuation;
-  }
-};
+// Tokenizes the whole main file, see TokenStream.
+TokenStream GenerateTokenStream(TranslationUnit& tu,
+                                const std::vector<std::string>& registerMacros);
 
-std::shared_ptr<TranslationUnit> GetTranslationUnit(ClangIndex& index, const std::string& filepath,
-                                                    const std::vector<const char*>& args);
+// Same as above, limited to the tokens of range, which may lie in any file of the translation unit.
+TokenStream GenerateTokenStream(TranslationUnit& tu, CXSourceRange range,
+                                const std::vector<std::string>& registerMacros);
 
-std::string GetFullQualifiedName(CXCursor cursor);
+// Parses RTTR_REGISTER_FUNCTION_AS_PROPERTY("property", function) starting at tokens[i].
+bool ParseFunctionAsProperty(const TokenStream& tokens, size_t i,
+                             std::pair<std::string, std::string>& propertyFromFunction);
 
-std::optional<CXCursor> FindNextMember(const std::vector<Token>& tokens, size_t startIndex,
-                                       CXCursorKind kind);
+// Annotations that the marker macros expand to with ExtractionEngine::Annotations.
+constexpr const char* RegisterAnnotation = "rttr:register";
+constexpr const char* SkipPropertyAnnotation = "rttr:skip";
+// Prefix of the static_assert message that RTTR_REGISTER_FUNCTION_AS_PROPERTY expands to, followed
+// by "property:function".
+constexpr const char* PropertyAnnotationPrefix = "rttr:property:";
 
-std::vector<std::string> ProcessProperty(CXCursor cursor, const std::string& property_macro,
-                                         CXCursorKind kind);
+// Returns true if the cursor has an __attribute__((annotate(annotation))) child.
+bool HasAnnotation(CXCursor cursor, const char* annotation);
 
-std::vector<Token> GenerateTokenList(TranslationUnit& tu);
+// Collects the properties and methods of a marked class in one visit of its children. Skipped
+// fields and RTTR_REGISTER_FUNCTION_AS_PROPERTY mappings are taken from the class itself, found in
+// a single tokenization of its extent or, with annotatedMarkers, as annotations in the AST.
+void ExtractClassInfo(CXCursor cursor, std::vector<RTTRMarkClassInfo>& classInfos,
+                      bool annotatedMarkers = false);
 
-void ParseRttrMarkClass(const std::vector<Token>& token_list,
-                        const std::vector<std::string>& registerMacros,
-                        std::vector<RTTRMarkClassInfo>& classInfos,
+void ExtractEnumInfo(CXCursor cursor, std::vector<RTTRMarkEnumInfo>& enumInfos);
+
+void ParseRttrMarkClass(const TokenStream& tokens, std::vector<RTTRMarkClassInfo>& classInfos,
                         std::vector<RTTRMarkEnumInfo>& enumInfos);
 
-void GenerateCPPCode(const std::vector<RTTRMarkClassInfo>& classInfos,
+// Writes the registration::class_ and registration::enumeration statements, indented for the
+// body of a registration function.
+void WriteRegistrationCode(std::ostream& f, const std::vector<RTTRMarkClassInfo>& classInfos,
+                           const std::vector<RTTRMarkEnumInfo>& enumInfos);
+
+// Writes the registration code into a single file. Returns false if it cannot be written.
+bool GenerateCPPCode(const std::vector<RTTRMarkClassInfo>& classInfos,
                      const std::vector<RTTRMarkEnumInfo>& enumInfos, const std::string& outputFile,
                      const std::vector<std::string>& relativePaths);
 
 void GetHeaderFiles(const std::filesystem::path& dir, std::vector<std::string>& files);
 
-void GetForwardDecl(TranslationUnit& tu,
-                    std::unordered_map<std::string, Register::ForwardDeclInfo>& map);
+// Calls visit with every .h and .hpp file under dir, or with dir itself if it is a header, in the
+// order GetHeaderFiles() returns them, as soon as each one is found. Stops early when visit
+// returns false.
+void VisitHeaderFiles(const std::filesystem::path& dir,
+                      const std::function<bool(const std::string&)>& visit);
 
-void GetClassDefHeaderFileList(TranslationUnit& tu,
-                               std::unordered_map<std::string, std::string>& DefList);
-void GetForwardDeclDefPath(const std::unordered_map<std::string, std::string>& DefList,
-                           std::vector<std::string>& path);
+// Returns the range covering the whole of filepath, if the translation unit contains that file.
+std::optional<CXSourceRange> GetFileRange(CXTranslationUnit tu, const std::string& filepath);
+
+// Returns the main file of the translation unit and every file it transitively includes.
+std::vector<std::string> GetIncludedFiles(CXTranslationUnit tu);
+
+// Returns the USRs of the classes, structs and enums defined in each file, in declaration order.
+// Only the main file is visited with mainFileOnly, otherwise every file except system headers.
+std::unordered_map<CXFile, std::vector<std::string>> GetDefinedTypes(CXTranslationUnit tu,
+                                                                   bool mainFileOnly);
 CXType getUnderlyingType(CXType type);
 bool typeIsDefined(CXType type);
-void printDiagnostics(CXTranslationUnit translationUnit);
+
+// Returns true if the type is a builtin type, or a class or enum declared in the main file, or a
+// pointer, reference or array of one. Only such types keep their meaning when a header is parsed
+// without its includes.
+bool IsSelfContainedType(CXType type);
+
+// Forgets the qualified names, copyability and wrapper templates cached by USR, which only hold
+// as long as the headers do not change. Must not be called while headers are being extracted.
+void ResetTypeCaches();
+
+// While an instance exists, the copyability of records is neither read from nor stored in the
+// run-wide cache on this thread. Used around CXTranslationUnit_SingleFileParse units, where the
+// declarations of the includes are missing, so answers would not hold for other units.
+class CopyabilityCacheBypass {
+ public:
+  CopyabilityCacheBypass();
+  ~CopyabilityCacheBypass();
+
+  CopyabilityCacheBypass(const CopyabilityCacheBypass&) = delete;
+  CopyabilityCacheBypass& operator=(const CopyabilityCacheBypass&) = delete;
+};
+
+// Returns true if any of the given classes, found in a CXTranslationUnit_SingleFileParse unit, has
+// a public field whose type, or a member of that type, cannot be resolved without the includes,
+// so that isUnCopiedType() could be wrong about it.
+bool NeedsSemanticParse(CXTranslationUnit tu, const std::vector<RTTRMarkClassInfo>& classInfos);
+
+// Returns true if the main file of the translation unit has diagnostics of error severity or worse.
+bool HasMainFileErrors(CXTranslationUnit tu);
+
+// Returns the number of register marker tokens in the main file. Every marked class or enum has
+// exactly one, so a smaller number of extracted types means some marked declarations were missed.
+size_t CountRegisterMarkers(TranslationUnit& tu, const std::vector<std::string>& registerMacros);
+// Prints every diagnostic of the translation unit. Returns true if any of them is an error; the
+// caller decides whether that is fatal.
+bool printDiagnostics(CXTranslationUnit translationUnit);
 
 }  // namespace Register
@@ -0,0 +1,117 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "resultSerializer.h"
+
+namespace Register {
+
+void WriteString(std::ostream& out, const std::string& str) {
+  out << str.size() << ' ' << str << '\n';
+}
+
+bool ReadString(std::istream& in, std::string& str) {
+  size_t size = 0;
+  if (!(in >> size) || in.get() != ' ') {
+    return false;
+  }
+  str.resize(size);
+  if (size > 0 && !in.read(&str[0], static_cast<std::streamsize>(size))) {
+    return false;
+  }
+  return in.get() == '\n';
+}
+
+void WriteStrings(std::ostream& out, const std::vector<std::string>& strs) {
+  out << strs.size() << '\n';
+  for (const auto& str : strs) {
+    WriteString(out, str);
+  }
+}
+
+bool ReadStrings(std::istream& in, std::vector<std::string>& strs) {
+  size_t count = 0;
+  if (!(in >> count)) {
+    return false;
+  }
+  strs.clear();
+  strs.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    std::string str;
+    if (!ReadString(in, str)) {
+      return false;
+    }
+    strs.push_back(std::move(str));
+  }
+  return true;
+}
+
+void WriteHeaderResult(std::ostream& out, const HeaderParseResult& result) {
+  out << result.classInfos.size() << '\n';
+  for (const auto& info : result.classInfos) {
+    WriteString(out, info.className);
+    WriteString(out, info.path);
+    WriteStrings(out, info.properties);
+    WriteStrings(out, info.methods);
+    WriteString(out, info.usr);
+    WriteStrings(out, info.propertyTypeUSRs);
+  }
+  out << result.enumInfos.size() << '\n';
+  for (const auto& info : result.enumInfos) {
+    WriteString(out, info.enumName);
+    WriteString(out, info.path);
+    WriteStrings(out, info.elements);
+    WriteString(out, info.usr);
+  }
+  WriteStrings(out, result.includedFiles);
+  WriteStrings(out, result.definedTypes);
+}
+
+bool ReadHeaderResult(std::istream& in, HeaderParseResult& result) {
+  result = {};
+  size_t count = 0;
+  if (!(in >> count)) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    RTTRMarkClassInfo info;
+    if (!ReadString(in, info.className) || !ReadString(in, info.path) ||
+        !ReadStrings(in, info.properties) || !ReadStrings(in, info.methods) ||
+        !ReadString(in, info.usr) || !ReadStrings(in, info.propertyTypeUSRs)) {
+      return false;
+    }
+    result.classInfos.push_back(std::move(info));
+  }
+  if (!(in >> count)) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    RTTRMarkEnumInfo info;
+    if (!ReadString(in, info.enumName) || !ReadString(in, info.path) ||
+        !ReadStrings(in, info.elements) || !ReadString(in, info.usr)) {
+      return false;
+    }
+    result.enumInfos.push_back(std::move(info));
+  }
+  if (!ReadStrings(in, result.includedFiles) || !ReadStrings(in, result.definedTypes)) {
+    return false;
+  }
+  result.parsed = true;
+  return true;
+}
+
+}  // namespace Register
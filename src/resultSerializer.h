@@ -0,0 +1,40 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+// Text format for extraction results. Every string is written as its byte length followed by the
+// bytes, so names and paths may contain any character.
+void WriteString(std::ostream& out, const std::string& str);
+bool ReadString(std::istream& in, std::string& str);
+
+void WriteStrings(std::ostream& out, const std::vector<std::string>& strs);
+bool ReadStrings(std::istream& in, std::vector<std::string>& strs);
+
+void WriteHeaderResult(std::ostream& out, const HeaderParseResult& result);
+bool ReadHeaderResult(std::istream& in, HeaderParseResult& result);
+
+}  // namespace Register
@@ -0,0 +1,215 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "shardMerge.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include "outputFile.h"
+#include "resultSerializer.h"
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+static constexpr const char* ShardVersion = "rttr-shard-2";
+
+// 工作目录下的路径存为相对路径, 各节点的检出目录可以不同
+static std::string ToStoredPath(const std::string& path) {
+  std::error_code ec;
+  fs::path relative = fs::relative(path, ec);
+  if (ec || relative.empty() || *relative.begin() == "..") {
+    return fs::absolute(path, ec).lexically_normal().generic_string();
+  }
+  return relative.generic_string();
+}
+
+static std::string FromStoredPath(const std::string& path) {
+  std::error_code ec;
+  return fs::absolute(path, ec).lexically_normal().string();
+}
+
+bool ShardSpecFromString(const std::string& str, ShardSpec& spec) {
+  size_t slash = str.find('/');
+  if (slash == std::string::npos || slash == 0 || slash + 1 == str.size() ||
+      str.find_first_not_of("0123456789/") != std::string::npos ||
+      str.find('/', slash + 1) != std::string::npos) {
+    return false;
+  }
+  unsigned long long index = 0;
+  unsigned long long count = 0;
+  try {
+    index = std::stoull(str.substr(0, slash));
+    count = std::stoull(str.substr(slash + 1));
+  } catch (const std::out_of_range&) {
+    return false;
+  }
+  if (count == 0 || index >= count || count > std::numeric_limits<unsigned>::max()) {
+    return false;
+  }
+  spec.index = static_cast<unsigned>(index);
+  spec.count = static_cast<unsigned>(count);
+  return true;
+}
+
+void SelectShard(const ShardSpec& spec, std::vector<std::string>& headFiles,
+                 std::vector<size_t>& indices) {
+  std::sort(headFiles.begin(), headFiles.end());
+  size_t total = headFiles.size();
+  size_t begin = total * spec.index / spec.count;
+  size_t end = total * (spec.index + 1) / spec.count;
+  headFiles = std::vector<std::string>(headFiles.begin() + begin, headFiles.begin() + end);
+  indices.clear();
+  for (size_t i = begin; i < end; ++i) {
+    indices.push_back(i);
+  }
+}
+
+bool WriteShardResults(const fs::path& path, const ShardSpec& spec,
+                       const std::vector<std::string>& headFiles,
+                       const std::vector<size_t>& indices,
+                       const std::vector<HeaderParseResult>& results) {
+  std::ostringstream out;
+  WriteString(out, ShardVersion);
+  out << spec.index << ' ' << spec.count << ' ' << headFiles.size() << '\n';
+  for (size_t i = 0; i < headFiles.size(); ++i) {
+    HeaderParseResult result = results[i];
+    for (auto& includedFile : result.includedFiles) {
+      includedFile = ToStoredPath(includedFile);
+    }
+    out << indices[i] << ' ';
+    WriteString(out, ToStoredPath(headFiles[i]));
+    WriteHeaderResult(out, result);
+  }
+  return WriteFileIfChanged(path, out.str()) != WriteStatus::Failed;
+}
+
+struct ShardEntry {
+  std::string headerFile;
+  HeaderParseResult result;
+};
+
+static bool ReadShardResults(const std::string& path, ShardSpec& spec,
+                             std::map<size_t, ShardEntry>& entries) {
+  std::ifstream in(path, std::ios::binary);
+  std::string version;
+  size_t count = 0;
+  if (!in.is_open() || !ReadString(in, version) || version != ShardVersion ||
+      !(in >> spec.index >> spec.count >> count)) {
+    std::cerr << "Error: " << path << " is not a shard result file" << std::endl;
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    size_t index = 0;
+    ShardEntry entry;
+    if (!(in >> index) || !ReadString(in, entry.headerFile) ||
+        !ReadHeaderResult(in, entry.result)) {
+      std::cerr << "Error: " << path << " is truncated or corrupt" << std::endl;
+      return false;
+    }
+    entry.headerFile = FromStoredPath(entry.headerFile);
+    for (auto& includedFile : entry.result.includedFiles) {
+      includedFile = FromStoredPath(includedFile);
+    }
+    if (!entries.emplace(index, std::move(entry)).second) {
+      std::cerr << "Error: Header " << index << " appears in more than one shard" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// 按 USR 去重, 保留第一个定义
+template <typename Info>
+static bool RemoveDuplicates(std::vector<Info>& infos, const std::string& headerFile,
+                             std::unordered_map<std::string, std::pair<Info, std::string>>& seen) {
+  bool consistent = true;
+  std::vector<Info> unique;
+  for (auto& info : infos) {
+    if (info.usr.empty()) {
+      unique.push_back(std::move(info));
+      continue;
+    }
+    auto iter = seen.find(info.usr);
+    if (iter == seen.end()) {
+      seen.emplace(info.usr, std::make_pair(info, headerFile));
+      unique.push_back(std::move(info));
+      continue;
+    }
+    if (!(iter->second.first == info)) {
+      std::cerr << "Error: Conflicting definitions of " << info.path << " in "
+                << iter->second.second << " and " << headerFile << std::endl;
+      consistent = false;
+    }
+  }
+  infos = std::move(unique);
+  return consistent;
+}
+
+bool MergeShardResults(const std::vector<std::string>& shardFiles,
+                       std::vector<std::string>& headFiles,
+                       std::vector<HeaderParseResult>& results) {
+  std::map<size_t, ShardEntry> entries;
+  std::vector<bool> shardSeen;
+  for (const auto& shardFile : shardFiles) {
+    ShardSpec spec;
+    if (!ReadShardResults(shardFile, spec, entries)) {
+      return false;
+    }
+    if (shardSeen.empty()) {
+      shardSeen.resize(spec.count, false);
+    }
+    if (spec.count != shardSeen.size() || spec.index >= spec.count) {
+      std::cerr << "Error: " << shardFile << " belongs to a run with " << spec.count
+                << " shards, expected " << shardSeen.size() << std::endl;
+      return false;
+    }
+    if (shardSeen[spec.index]) {
+      std::cerr << "Error: Shard " << spec.index << "/" << spec.count << " is given twice"
+                << std::endl;
+      return false;
+    }
+    shardSeen[spec.index] = true;
+  }
+  bool success = true;
+  for (size_t i = 0; i < shardSeen.size(); ++i) {
+    if (!shardSeen[i]) {
+      std::cerr << "Error: Shard " << i << "/" << shardSeen.size() << " is missing" << std::endl;
+      success = false;
+    }
+  }
+
+  std::unordered_map<std::string, std::pair<RTTRMarkClassInfo, std::string>> classes;
+  std::unordered_map<std::string, std::pair<RTTRMarkEnumInfo, std::string>> enums;
+  headFiles.clear();
+  results.clear();
+  for (auto& [index, entry] : entries) {
+    success = RemoveDuplicates(entry.result.classInfos, entry.headerFile, classes) && success;
+    success = RemoveDuplicates(entry.result.enumInfos, entry.headerFile, enums) && success;
+    headFiles.push_back(std::move(entry.headerFile));
+    results.push_back(std::move(entry.result));
+  }
+  return success;
+}
+
+}  // namespace Register
@@ -0,0 +1,62 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+struct ShardSpec {
+  // Zero-based index of this shard.
+  unsigned index = 0;
+  unsigned count = 1;
+};
+
+// Parses "K/N" with 0 <= K < N.
+bool ShardSpecFromString(const std::string& str, ShardSpec& spec);
+
+// Sorts headFiles by path, so that every node sees the same order whatever its file system
+// returns, and keeps the contiguous range that belongs to the shard. indices receives the
+// position of each kept header in the sorted list of all headers.
+void SelectShard(const ShardSpec& spec, std::vector<std::string>& headFiles,
+                 std::vector<size_t>& indices);
+
+// Writes the results of one shard to an intermediate file that "merge" combines with the others.
+// Header and included file paths below the working directory are stored relative to it, so that
+// nodes can use checkouts at different absolute paths as long as each runs from the same
+// directory of its checkout. Other paths, e.g. system headers, are stored as absolute paths.
+bool WriteShardResults(const std::filesystem::path& path, const ShardSpec& spec,
+                       const std::vector<std::string>& headFiles,
+                       const std::vector<size_t>& indices,
+                       const std::vector<HeaderParseResult>& results);
+
+// Reads the intermediate files of all shards and returns their headers and results in the order
+// of the sorted header list, which is the order a single run over that list would produce.
+// Relative paths are resolved against the working directory of the merge.
+// Classes and enums registered by more than one header are kept once, by USR; identical copies
+// are dropped silently and differing ones are reported as conflicts. Returns false if a file
+// cannot be read, shards are missing or duplicated, or there are conflicts.
+bool MergeShardResults(const std::vector<std::string>& shardFiles,
+                       std::vector<std::string>& headFiles,
+                       std::vector<HeaderParseResult>& results);
+
+}  // namespace Register
@@ -0,0 +1,162 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "shardedOutput.h"
+#include <algorithm>
+#include <cctype>
+#include <set>
+#include <sstream>
+#include "declarationIndex.h"
+#include "outputFile.h"
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+static constexpr size_t TypesPerShard = 50;
+static constexpr unsigned MaxAutoShards = 32;
+
+unsigned GetAutoShardCount(size_t numTypes) {
+  size_t shards = (numTypes + TypesPerShard - 1) / TypesPerShard;
+  return static_cast<unsigned>(std::clamp<size_t>(shards, 1, MaxAutoShards));
+}
+
+static std::string GetShardFunctionName(const std::string& stem, unsigned shard) {
+  std::string name = "RttrAutoRegister_";
+  for (char c : stem) {
+    name += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+  }
+  return name + "_Shard" + std::to_string(shard);
+}
+
+static fs::path GetShardPath(const fs::path& outputFile, unsigned shard) {
+  return outputFile.parent_path() /
+         (outputFile.stem().string() + "_shard" + std::to_string(shard) + ".cpp");
+}
+
+// Removes <stem>_shard<K>.cpp files with K >= shardCount.
+static void RemoveStaleShards(const fs::path& outputFile, unsigned shardCount) {
+  std::string prefix = outputFile.stem().string() + "_shard";
+  fs::path directory = outputFile.parent_path().empty() ? "." : outputFile.parent_path();
+  std::error_code ec;
+  for (const auto& entry : fs::directory_iterator(directory, ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.size() <= prefix.size() + 4 || name.compare(0, prefix.size(), prefix) != 0 ||
+        entry.path().extension() != ".cpp") {
+      continue;
+    }
+    std::string number = name.substr(prefix.size(), name.size() - prefix.size() - 4);
+    if (number.find_first_not_of("0123456789") != std::string::npos ||
+        std::stoul(number) < shardCount) {
+      continue;
+    }
+    fs::remove(entry.path(), ec);
+  }
+}
+
+bool GenerateShardedCode(const std::vector<std::string>& headFiles,
+                         const std::vector<HeaderParseResult>& results,
+                         const fs::path& outputFile, unsigned shardCount) {
+  fs::path directory = outputFile.parent_path();
+
+  // 头文件按类型数量从多到少, 同样多时按相对路径排序, 依次放入类型最少的分片
+  struct ShardedHeader {
+    size_t index;
+    size_t numTypes;
+    std::string relativePath;
+  };
+  std::vector<ShardedHeader> sortedHeaders;
+  for (size_t i = 0; i < headFiles.size() && i < results.size(); ++i) {
+    size_t numTypes = results[i].classInfos.size() + results[i].enumInfos.size();
+    if (numTypes > 0) {
+      std::string relativePath = fs::relative(headFiles[i], directory).generic_string();
+      sortedHeaders.push_back({i, numTypes, relativePath});
+    }
+  }
+  std::sort(sortedHeaders.begin(), sortedHeaders.end(),
+            [](const ShardedHeader& lhs, const ShardedHeader& rhs) {
+              if (lhs.numTypes != rhs.numTypes) {
+                return lhs.numTypes > rhs.numTypes;
+              }
+              return lhs.relativePath < rhs.relativePath;
+            });
+  // 头文件少于分片数时不生成空分片
+  shardCount = static_cast<unsigned>(
+      std::clamp<size_t>(sortedHeaders.size(), 1, std::max(shardCount, 1u)));
+  std::vector<std::vector<size_t>> shardHeaders(shardCount);
+  std::vector<size_t> shardTypes(shardCount, 0);
+  for (const auto& header : sortedHeaders) {
+    size_t shard = std::min_element(shardTypes.begin(), shardTypes.end()) - shardTypes.begin();
+    shardHeaders[shard].push_back(header.index);
+    shardTypes[shard] += header.numTypes;
+  }
+  for (auto& headers : shardHeaders) {
+    std::sort(headers.begin(), headers.end());
+  }
+
+  std::string stem = outputFile.stem().string();
+  DeclarationIndex declarationIndex(headFiles, results);
+  for (unsigned shard = 0; shard < shardCount; ++shard) {
+    std::vector<RTTRMarkClassInfo> classInfos;
+    std::vector<RTTRMarkEnumInfo> enumInfos;
+    std::set<size_t> requiredHeaders;
+    for (size_t i : shardHeaders[shard]) {
+      declarationIndex.CollectRequiredHeaders(results[i], i, requiredHeaders);
+      classInfos.insert(classInfos.end(), results[i].classInfos.begin(),
+                        results[i].classInfos.end());
+      enumInfos.insert(enumInfos.end(), results[i].enumInfos.begin(), results[i].enumInfos.end());
+    }
+    declarationIndex.RemoveIncludedHeaders(requiredHeaders);
+
+    std::ostringstream f;
+    f << "// Auto-generated code\n";
+    f << "#include <rttr/registration.h>\n";
+    for (size_t i : requiredHeaders) {
+      f << "#include \"" << fs::relative(headFiles[i], directory).string() << "\"\n";
+    }
+    f << "\n";
+    f << "void " << GetShardFunctionName(stem, shard) << "()\n";
+    f << "{\n";
+    f << "\tusing namespace rttr;\n\n";
+    WriteRegistrationCode(f, classInfos, enumInfos);
+    f << "}\n";
+    if (WriteFileIfChanged(GetShardPath(outputFile, shard), f.str()) == WriteStatus::Failed) {
+      return false;
+    }
+  }
+  RemoveStaleShards(outputFile, shardCount);
+
+  std::ostringstream f;
+  f << "// Auto-generated code\n";
+  f << "#include <rttr/registration.h>\n";
+  f << "#include <iostream>\n\n";
+  for (unsigned shard = 0; shard < shardCount; ++shard) {
+    f << "void " << GetShardFunctionName(stem, shard) << "();\n";
+  }
+  f << "\n";
+  f << "RTTR_REGISTRATION\n";
+  f << "{\n";
+  f << "\tstd::cout << \"Rttr registed!\" << std::endl;\n\n";
+  for (unsigned shard = 0; shard < shardCount; ++shard) {
+    f << "\t" << GetShardFunctionName(stem, shard) << "();\n";
+  }
+  f << "}\n";
+  return WriteFileIfChanged(outputFile, f.str()) != WriteStatus::Failed;
+}
+
+}  // namespace Register
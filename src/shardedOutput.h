@@ -0,0 +1,45 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+// Returns the shard count used for "--shards auto", based on the number of registered types.
+unsigned GetAutoShardCount(size_t numTypes);
+
+// Writes the registration code split into shardCount source files that can be compiled in
+// parallel. Shard K is written next to outputFile as <stem>_shard<K>.cpp, holds one registration
+// function and includes only the headers its types need. outputFile itself becomes the aggregator:
+// a single RTTR_REGISTRATION block that calls every shard function. Headers are kept whole. They
+// are taken by decreasing number of registered types, ties broken by path, and each goes to the
+// shard with the fewest types so far, so shards stay balanced and the assignment only depends on
+// the headers, not on their input order. With fewer headers than shardCount, only one shard per
+// header is written. Shard files left over from an earlier run with more shards are removed, and
+// files whose contents did not change are left untouched. Returns false if a file cannot be
+// written.
+bool GenerateShardedCode(const std::vector<std::string>& headFiles,
+                         const std::vector<HeaderParseResult>& results,
+                         const std::filesystem::path& outputFile, unsigned shardCount);
+
+}  // namespace Register
@@ -0,0 +1,180 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "streamingPipeline.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include "boundedQueue.h"
+#include "extractionCache.h"
+#include "markerPrefilter.h"
+#include "memoryBudget.h"
+#include "parseStats.h"
+
+namespace Register {
+
+// 队列容量只需让各阶段保持忙碌, 不需要缓存整个目录树
+static constexpr size_t QueueCapacity = 256;
+
+struct QueuedHeader {
+  // Position among the headers that passed the prefilter.
+  size_t sequence = 0;
+  std::string file;
+};
+
+struct CompletedHeader {
+  size_t sequence = 0;
+  std::string file;
+  HeaderParseResult result;
+  bool success = false;
+};
+
+bool RunStreamingPipeline(const std::vector<std::string>& searchPaths,
+                          const ProcessOptions& options, bool prefilter,
+                          StreamingResult& output) {
+  output = {};
+  unsigned jobs = options.jobs;
+  if (jobs == 0) {
+    jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+  bool useCache = !options.cacheDir.empty() && options.parseMode != ParseMode::Compare;
+  std::unique_ptr<ExtractionCache> cache;
+  if (useCache) {
+    cache = std::make_unique<ExtractionCache>(options.cacheDir, options);
+  }
+  ParseStats stats;
+  if (!options.statsFile.empty()) {
+    stats.Load(options.statsFile);
+  }
+  MemoryBudget budget(options.maxMemory);
+
+  BoundedQueue<std::string> discovered(QueueCapacity);
+  BoundedQueue<QueuedHeader> marked(QueueCapacity);
+  BoundedQueue<CompletedHeader> completed(QueueCapacity);
+  std::atomic<bool> failed{false};
+  std::atomic<unsigned> activeParsers{jobs};
+  size_t skipped = 0;
+
+  std::thread discoverThread([&]() {
+    try {
+      for (const auto& searchPath : searchPaths) {
+        VisitHeaderFiles(searchPath, [&](const std::string& file) {
+          output.searchedHeaders.push_back(file);
+          return discovered.Push(file);
+        });
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      failed = true;
+    }
+    discovered.Close();
+  });
+
+  std::thread prefilterThread([&]() {
+    MarkerScanner scanner(GetPrefilterMarkers(options.registerMacros));
+    size_t sequence = 0;
+    std::string file;
+    while (discovered.Pop(file)) {
+      if (prefilter && !scanner.FileContains(file)) {
+        skipped++;
+        continue;
+      }
+      if (!marked.Push({sequence++, file})) {
+        break;
+      }
+    }
+    // 下游停止后让发现阶段也尽快停下
+    discovered.Close();
+    marked.Close();
+  });
+
+  auto parser = [&]() {
+    ClangIndex index;
+    if (!index) {
+      std::cerr << "Failed to create Clang index\n";
+      failed = true;
+      marked.Close();
+    }
+    auto args = GetArgPointers(options.args);
+    QueuedHeader header;
+    while (index && !failed && marked.Pop(header)) {
+      CompletedHeader done;
+      done.sequence = header.sequence;
+      done.file = std::move(header.file);
+      if (cache && cache->Load(done.file, done.result)) {
+        done.result.fromCache = true;
+        done.success = true;
+      } else {
+        done.result = {};
+        uint64_t expected = stats.GetMemory(done.file);
+        uint64_t reservation = expected > 0 ? expected : budget.GetUnknownEstimate();
+        budget.Acquire(reservation);
+        done.success = ProcessHeaderFile(index, done.file, args, options, done.result);
+        budget.RecordMeasured(done.result.memoryBytes);
+        budget.Release(reservation);
+      }
+      if (!done.success) {
+        // 与线程池一样, 出错后不再开始新的头文件
+        failed = true;
+        marked.Close();
+      }
+      completed.Push(std::move(done));
+    }
+    if (--activeParsers == 0) {
+      completed.Close();
+    }
+  };
+  std::vector<std::thread> parseThreads;
+  parseThreads.reserve(jobs);
+  for (unsigned i = 0; i < jobs; ++i) {
+    parseThreads.emplace_back(parser);
+  }
+
+  // 按完成顺序收集, 最后按发现顺序排列
+  std::map<size_t, CompletedHeader> collected;
+  CompletedHeader done;
+  while (completed.Pop(done)) {
+    if (cache && done.success && !done.result.fromCache) {
+      cache->Store(done.file, done.result);
+    }
+    size_t sequence = done.sequence;
+    collected.emplace(sequence, std::move(done));
+  }
+
+  for (auto& thread : parseThreads) {
+    thread.join();
+  }
+  prefilterThread.join();
+  discoverThread.join();
+
+  for (auto& [sequence, header] : collected) {
+    output.headFiles.push_back(std::move(header.file));
+    output.results.push_back(std::move(header.result));
+  }
+  if (prefilter) {
+    std::cout << "Prefilter skipped " << skipped << " of " << output.searchedHeaders.size()
+              << " headers without registration macros\n";
+  }
+  UpdateParseStats(output.headFiles, output.results, options);
+  return !failed;
+}
+
+}  // namespace Register
@@ -0,0 +1,47 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+struct StreamingResult {
+  // Every header found, including those removed by the prefilter.
+  std::vector<std::string> searchedHeaders;
+  // The headers that passed the prefilter, in discovery order, and their results.
+  std::vector<std::string> headFiles;
+  std::vector<HeaderParseResult> results;
+};
+
+// Runs discover -> prefilter -> parse and extract -> collect as concurrent stages connected by
+// bounded queues, so the first header is parsed while the directory walk is still running and a
+// slow walk on a network file system is hidden behind parsing. Parsing uses options.jobs
+// threads, the extraction cache and options.maxMemory. Cache entries are written as soon as
+// each header completes. Results come back in discovery order, which is the order of
+// GetHeaderFiles(), so the generated code matches a run without streaming. Umbrella units,
+// worker processes and cost-ordered scheduling need the whole header list up front and are not
+// used. Stops taking new headers after the first failure and returns false.
+bool RunStreamingPipeline(const std::vector<std::string>& searchPaths,
+                          const ProcessOptions& options, bool prefilter,
+                          StreamingResult& output);
+
+}  // namespace Register
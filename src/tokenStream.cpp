@@ -0,0 +1,138 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "tokenStream.h"
+#include <algorithm>
+#include <cstring>
+#include "clangraii/clangString.h"
+
+namespace Register {
+
+// Beyond this many marked tokens, annotating the whole range in one call is cheaper than
+// annotating each marked token on its own.
+static constexpr size_t MaxSparseAnnotations = 32;
+
+TokenStream::TokenStream(const std::vector<std::string>& registerMacros) {
+  // 预先登记标记宏, 扫描时只需按 id 查表
+  for (const auto& macro : registerMacros) {
+    markerKinds[Intern(macro)] = MarkerKind::Register;
+  }
+  markerKinds[Intern("RTTR_REGISTER_FUNCTION_AS_PROPERTY")] = MarkerKind::FunctionAsProperty;
+  markerKinds[Intern("RTTR_SKIP_REGISTER_PROPERTY")] = MarkerKind::SkipProperty;
+}
+
+std::string_view TokenStream::Store(std::string_view spelling) {
+  // 过长的拼写单独分配, 不占用当前块
+  if (spelling.size() > ArenaBlockSize / 4) {
+    arenaBlocks.emplace_back(new char[spelling.size()]);
+    memcpy(arenaBlocks.back().get(), spelling.data(), spelling.size());
+    return {arenaBlocks.back().get(), spelling.size()};
+  }
+  if (!arenaBlock || arenaUsed + spelling.size() > ArenaBlockSize) {
+    arenaBlocks.emplace_back(new char[ArenaBlockSize]);
+    arenaBlock = arenaBlocks.back().get();
+    arenaUsed = 0;
+  }
+  char* data = arenaBlock + arenaUsed;
+  memcpy(data, spelling.data(), spelling.size());
+  arenaUsed += spelling.size();
+  return {data, spelling.size()};
+}
+
+uint32_t TokenStream::Intern(std::string_view spelling) {
+  auto iter = spellingIds.find(spelling);
+  if (iter != spellingIds.end()) {
+    return iter->second;
+  }
+  std::string_view stored = Store(spelling);
+  auto id = static_cast<uint32_t>(spellings.size());
+  spellings.push_back(stored);
+  markerKinds.push_back(MarkerKind::None);
+  spellingIds.emplace(stored, id);
+  return id;
+}
+
+void TokenStream::Tokenize(CXTranslationUnit tu, CXSourceRange range) {
+  CXToken* tokens = nullptr;
+  unsigned numTokens = 0;
+  clang_tokenize(tu, range, &tokens, &numTokens);
+
+  size_t first = ids.size();
+  kinds.reserve(first + numTokens);
+  ids.reserve(first + numTokens);
+  for (unsigned i = 0; i < numTokens; ++i) {
+    ClangString spelling(clang_getTokenSpelling(tu, tokens[i]));
+    kinds.push_back(static_cast<uint8_t>(clang_getTokenKind(tokens[i])));
+    ids.push_back(Intern(spelling.view()));
+  }
+
+  // 只记录标记宏的位置和紧跟注册宏的 token
+  std::vector<unsigned> marked;
+  for (unsigned i = 0; i < numTokens; ++i) {
+    MarkerKind kind = markerKinds[ids[first + i]];
+    if (kind == MarkerKind::None) {
+      continue;
+    }
+    unsigned offset = 0;
+    clang_getFileLocation(clang_getTokenLocation(tu, tokens[i]), nullptr, nullptr, nullptr,
+                          &offset);
+    offsets.emplace_back(static_cast<uint32_t>(first + i), offset);
+    if (kind == MarkerKind::Register && i + 1 < numTokens) {
+      marked.push_back(i + 1);
+    }
+  }
+
+  // 标记较少时逐个标注, 每次只遍历覆盖该 token 的 AST 区域; 较多时整体批量标注一次
+  if (marked.size() > MaxSparseAnnotations) {
+    std::vector<CXCursor> annotated(numTokens);
+    clang_annotateTokens(tu, tokens, numTokens, annotated.data());
+    for (unsigned index : marked) {
+      cursors.emplace_back(static_cast<uint32_t>(first + index), annotated[index]);
+    }
+  } else {
+    for (unsigned index : marked) {
+      CXCursor cursor;
+      clang_annotateTokens(tu, &tokens[index], 1, &cursor);
+      cursors.emplace_back(static_cast<uint32_t>(first + index), cursor);
+    }
+  }
+  clang_disposeTokens(tu, tokens, numTokens);
+}
+
+template <typename T>
+static const T* FindByIndex(const std::vector<std::pair<uint32_t, T>>& entries, size_t i) {
+  auto iter = std::lower_bound(
+      entries.begin(), entries.end(), i,
+      [](const std::pair<uint32_t, T>& entry, size_t index) { return entry.first < index; });
+  if (iter == entries.end() || iter->first != i) {
+    return nullptr;
+  }
+  return &iter->second;
+}
+
+CXCursor TokenStream::cursor(size_t i) const {
+  const CXCursor* cursor = FindByIndex(cursors, i);
+  return cursor ? *cursor : clang_getNullCursor();
+}
+
+unsigned TokenStream::offset(size_t i) const {
+  const unsigned* offset = FindByIndex(offsets, i);
+  return offset ? *offset : 0;
+}
+
+}  // namespace Register
@@ -0,0 +1,94 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <clang-c/Index.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Register {
+
+enum class MarkerKind : uint8_t { None, Register, FunctionAsProperty, SkipProperty };
+
+// The tokens of a source range in struct-of-arrays form. Every distinct spelling is interned once
+// into an arena owned by the stream, and each token only stores its kind and spelling id, so
+// scanning for markers compares integers instead of strings. Cursors are only kept for the tokens
+// right after a register marker, the only ones ParseRttrMarkClass reads, and file offsets only for
+// marker tokens.
+class TokenStream {
+ public:
+  explicit TokenStream(const std::vector<std::string>& registerMacros);
+
+  TokenStream(TokenStream&&) = default;
+  TokenStream& operator=(TokenStream&&) = default;
+  TokenStream(const TokenStream&) = delete;
+  TokenStream& operator=(const TokenStream&) = delete;
+
+  // Appends the tokens of range and resolves the cursors of the tokens following register markers.
+  void Tokenize(CXTranslationUnit tu, CXSourceRange range);
+
+  size_t size() const {
+    return ids.size();
+  }
+
+  CXTokenKind kind(size_t i) const {
+    return static_cast<CXTokenKind>(kinds[i]);
+  }
+
+  MarkerKind marker(size_t i) const {
+    return markerKinds[ids[i]];
+  }
+
+  std::string_view spelling(size_t i) const {
+    return spellings[ids[i]];
+  }
+
+  // Returns the null cursor for tokens that do not follow a register marker.
+  CXCursor cursor(size_t i) const;
+
+  // Returns the file offset of a marker token, or 0 for other tokens.
+  unsigned offset(size_t i) const;
+
+ private:
+  static constexpr size_t ArenaBlockSize = 64 * 1024;
+
+  std::vector<uint8_t> kinds;
+  std::vector<uint32_t> ids;
+  // (token index, cursor), sorted by token index.
+  std::vector<std::pair<uint32_t, CXCursor>> cursors;
+  // (token index, file offset) of marker tokens, sorted by token index.
+  std::vector<std::pair<uint32_t, unsigned>> offsets;
+
+  std::vector<std::string_view> spellings;
+  std::vector<MarkerKind> markerKinds;
+  std::unordered_map<std::string_view, uint32_t> spellingIds;
+  std::vector<std::unique_ptr<char[]>> arenaBlocks;
+  char* arenaBlock = nullptr;
+  size_t arenaUsed = 0;
+
+  uint32_t Intern(std::string_view spelling);
+  std::string_view Store(std::string_view spelling);
+};
+
+}  // namespace Register
@@ -0,0 +1,289 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "umbrellaUnit.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include "clangraii/clangDiagnostic.h"
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+struct InclusionGraph {
+  CXTranslationUnit tu = nullptr;
+  // File name -> index of the umbrella #include line that first brought the file in.
+  std::unordered_map<std::string, size_t> owners;
+  // File name -> files it brought in. Only the first #include of a file is reported, later ones
+  // are skipped by its include guard and found by ScanIncludeNames() instead.
+  std::unordered_map<std::string, std::vector<std::string>> children;
+  // Every file of the translation unit, and those that are not system headers.
+  std::vector<std::string> files;
+  std::vector<std::string> userFiles;
+};
+
+static void VisitInclusion(CXFile included_file, CXSourceLocation* inclusion_stack,
+                           unsigned include_len, CXClientData client_data) {
+  if (include_len == 0) {
+    return;
+  }
+  auto data = static_cast<InclusionGraph*>(client_data);
+  std::string filename = ClangString(clang_getFileName(included_file)).str();
+  data->files.push_back(filename);
+  if (!clang_Location_isInSystemHeader(clang_getLocation(data->tu, included_file, 1, 1))) {
+    data->userFiles.push_back(filename);
+  }
+  // 栈顶是直接包含该文件的 #include 行
+  CXFile parent = nullptr;
+  clang_getSpellingLocation(inclusion_stack[0], &parent, nullptr, nullptr, nullptr);
+  if (parent) {
+    data->children[ClangString(clang_getFileName(parent)).str()].push_back(filename);
+  }
+  // 栈底是伞形文件中的 #include 行, 每个头文件占一行
+  unsigned line = 0;
+  clang_getSpellingLocation(inclusion_stack[include_len - 1], nullptr, &line, nullptr, nullptr);
+  if (line != 0) {
+    data->owners.emplace(filename, line - 1);
+  }
+}
+
+// Returns the names written in the #include and #import lines of a file, e.g. "a/b.h". Lines in
+// disabled #if blocks are returned as well, which only adds dependencies.
+static std::vector<std::string> ScanIncludeNames(const std::string& file) {
+  std::vector<std::string> names;
+  std::ifstream in(file);
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t pos = line.find_first_not_of(" \t");
+    if (pos == std::string::npos || line[pos] != '#') {
+      continue;
+    }
+    pos = line.find_first_not_of(" \t", pos + 1);
+    if (pos == std::string::npos ||
+        (line.compare(pos, 7, "include") != 0 && line.compare(pos, 6, "import") != 0)) {
+      continue;
+    }
+    size_t open = line.find_first_of("<\"", pos);
+    if (open == std::string::npos) {
+      continue;
+    }
+    size_t close = line.find(line[open] == '<' ? '>' : '"', open + 1);
+    if (close != std::string::npos && close > open + 1) {
+      names.push_back(line.substr(open + 1, close - open - 1));
+    }
+  }
+  return names;
+}
+
+// Returns, for every file of the umbrella, the files it includes directly. Include guards hide
+// the repeated includes of a file from clang_getInclusions(), so the #include lines of the files
+// outside of system headers are matched against the files of the translation unit by name.
+static std::unordered_map<std::string, std::vector<std::string>> GetIncludeEdges(
+    const InclusionGraph& graph) {
+  std::unordered_map<std::string, std::vector<std::string>> filesByName;
+  for (const auto& file : graph.files) {
+    filesByName[fs::path(file).filename().string()].push_back(file);
+  }
+  auto edges = graph.children;
+  for (const auto& file : graph.userFiles) {
+    auto& targets = edges[file];
+    for (const auto& name : ScanIncludeNames(file)) {
+      auto candidates = filesByName.find(fs::path(name).filename().string());
+      if (candidates == filesByName.end()) {
+        continue;
+      }
+      // 含 ".." 的相对路径无法按后缀匹配, 保守地取所有同名文件
+      std::string suffix = "/" + fs::path(name).generic_string();
+      bool anyMatch = name.find("..") != std::string::npos;
+      for (const auto& candidate : candidates->second) {
+        std::string path = fs::path(candidate).generic_string();
+        if (anyMatch || (path.size() >= suffix.size() &&
+                         path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0)) {
+          targets.push_back(candidate);
+        }
+      }
+    }
+  }
+  return edges;
+}
+
+// Returns the header and every file it includes transitively.
+static std::vector<std::string> CollectIncludedFiles(
+    const std::unordered_map<std::string, std::vector<std::string>>& edges,
+    const std::string& header) {
+  std::vector<std::string> files = {header};
+  std::unordered_set<std::string> visited = {header};
+  for (size_t i = 0; i < files.size(); ++i) {
+    auto iter = edges.find(files[i]);
+    if (iter == edges.end()) {
+      continue;
+    }
+    for (const auto& child : iter->second) {
+      if (visited.insert(child).second) {
+        files.push_back(child);
+      }
+    }
+  }
+  return files;
+}
+
+static std::string GetFileName(CXTranslationUnit tu, const std::string& path) {
+  CXFile file = clang_getFile(tu, path.c_str());
+  if (!file) {
+    return "";
+  }
+  return ClangString(clang_getFileName(file)).str();
+}
+
+// Marks the headers that caused an error. Returns false if an error cannot be attributed to any
+// header, in which case nothing parsed by the umbrella can be trusted.
+static bool MarkFailedHeaders(CXTranslationUnit tu, const InclusionGraph& data,
+                              const std::vector<std::string>& headerNames,
+                              std::vector<bool>& failed) {
+  std::unordered_map<std::string, size_t> headerIndices;
+  for (size_t i = 0; i < headerNames.size(); ++i) {
+    if (!headerNames[i].empty()) {
+      headerIndices.emplace(headerNames[i], i);
+    }
+  }
+
+  unsigned numDiagnostics = clang_getNumDiagnostics(tu);
+  for (unsigned i = 0; i < numDiagnostics; ++i) {
+    ClangDiagnostic diagnostic(clang_getDiagnostic(tu, i));
+    if (clang_getDiagnosticSeverity(diagnostic) < CXDiagnostic_Error) {
+      continue;
+    }
+    CXSourceLocation location = clang_getDiagnosticLocation(diagnostic);
+    CXFile file = nullptr;
+    unsigned line = 0;
+    clang_getSpellingLocation(location, &file, &line, nullptr, nullptr);
+    if (!file) {
+      return false;
+    }
+    if (clang_Location_isFromMainFile(location)) {
+      if (line == 0 || line > failed.size()) {
+        return false;
+      }
+      failed[line - 1] = true;
+      continue;
+    }
+    ClangString filename(clang_getFileName(file));
+    bool attributed = false;
+    auto owner = data.owners.find(filename.str());
+    if (owner != data.owners.end() && owner->second < failed.size()) {
+      failed[owner->second] = true;
+      attributed = true;
+    }
+    auto header = headerIndices.find(filename.str());
+    if (header != headerIndices.end()) {
+      failed[header->second] = true;
+      attributed = true;
+    }
+    if (!attributed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ProcessUmbrellaUnit(const std::vector<std::string>& headFiles, const ProcessOptions& options,
+                         std::vector<HeaderParseResult>& results,
+                         std::vector<size_t>& failedHeaders) {
+  results.clear();
+  results.resize(headFiles.size());
+  failedHeaders.clear();
+  auto failAll = [&]() {
+    failedHeaders.clear();
+    for (size_t i = 0; i < headFiles.size(); ++i) {
+      failedHeaders.push_back(i);
+    }
+    for (auto& result : results) {
+      result = {};
+    }
+  };
+
+  // 每行包含一个头文件, 诊断信息的行号即头文件下标
+  std::vector<std::string> absolutePaths;
+  std::string contents;
+  for (const auto& headerFile : headFiles) {
+    absolutePaths.push_back(fs::absolute(headerFile).lexically_normal().string());
+    contents += "#include \"" + fs::path(absolutePaths.back()).generic_string() + "\"\n";
+  }
+  std::string umbrellaPath = (fs::current_path() / "__rttr_umbrella__.cpp").string();
+  CXUnsavedFile unsavedFile = {umbrellaPath.c_str(), contents.c_str(),
+                               static_cast<unsigned long>(contents.size())};
+
+  std::cout << "Process umbrella of " << headFiles.size() << " headers" << std::endl;
+  ClangIndex index;
+  if (!index) {
+    std::cerr << "Failed to create Clang index\n";
+    failAll();
+    return false;
+  }
+  // 某个头文件的致命错误不应中断后续头文件的解析
+  TranslationUnit tu(index, umbrellaPath, GetArgPointers(options.args),
+                     GetParseOptions(options.parseMode) | CXTranslationUnit_KeepGoing,
+                     {unsavedFile});
+  if (!tu) {
+    std::cerr << "Failed to parse umbrella translation unit (error code " << tu.error() << ")\n";
+    failAll();
+    return false;
+  }
+
+  std::vector<std::string> headerNames;
+  for (const auto& path : absolutePaths) {
+    headerNames.push_back(GetFileName(tu, path));
+  }
+  InclusionGraph graph;
+  graph.tu = tu;
+  clang_getInclusions(tu, VisitInclusion, &graph);
+  std::vector<bool> failed(headFiles.size(), false);
+  if (!MarkFailedHeaders(tu, graph, headerNames, failed)) {
+    std::cerr << "Umbrella translation unit has errors outside of the parsed headers\n";
+    failAll();
+    return true;
+  }
+
+  auto includeEdges = GetIncludeEdges(graph);
+  std::unordered_map<std::string, std::vector<std::string>> definedTypes;
+  for (auto& [file, types] : GetDefinedTypes(tu, false)) {
+    definedTypes[ClangString(clang_getFileName(file)).str()] = std::move(types);
+  }
+  for (size_t i = 0; i < headFiles.size(); ++i) {
+    auto range = failed[i] ? std::nullopt : GetFileRange(tu, absolutePaths[i]);
+    if (!range) {
+      failedHeaders.push_back(i);
+      continue;
+    }
+    std::cout << "Process file : " << headFiles[i] << std::endl;
+    auto tokens = GenerateTokenStream(tu, *range, options.registerMacros);
+    ParseRttrMarkClass(tokens, results[i].classInfos, results[i].enumInfos);
+    results[i].includedFiles = CollectIncludedFiles(includeEdges, headerNames[i]);
+    auto types = definedTypes.find(headerNames[i]);
+    if (types != definedTypes.end()) {
+      results[i].definedTypes = types->second;
+    }
+    results[i].parsed = true;
+  }
+  return true;
+}
+
+}  // namespace Register
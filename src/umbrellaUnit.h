@@ -0,0 +1,37 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+// Builds an in-memory source that includes every header, parses it once, and extracts each
+// header from its own file range, so results[i] still belongs to headFiles[i]. Headers that caused
+// errors in the umbrella, or that it does not contain, are not extracted and are returned in
+// failedHeaders, for the caller to parse on their own. Returns false if the umbrella itself could
+// not be parsed, in which case every header is listed in failedHeaders. The includedFiles of each
+// result only list the files that header includes transitively.
+bool ProcessUmbrellaUnit(const std::vector<std::string>& headFiles, const ProcessOptions& options,
+                         std::vector<HeaderParseResult>& results,
+                         std::vector<size_t>& failedHeaders);
+
+}  // namespace Register
@@ -0,0 +1,80 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <clang-c/Index.h>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include "clangraii/clangString.h"
+
+namespace Register {
+
+// Returns the USR of the cursor's declaration, which names the same entity in every translation
+// unit. Empty for cursors without one.
+inline std::string GetUSR(CXCursor cursor) {
+  return ClangString(clang_getCursorUSR(cursor)).str();
+}
+
+// Answers about declarations that hold for the whole run, keyed by USR. Cursors and types belong
+// to one translation unit, but a USR does not, so entries are shared by every translation unit
+// and every worker thread. Watch mode clears them before every update, since edited headers can
+// change the answers.
+template <typename T>
+class UsrCache {
+ public:
+  std::optional<T> Find(const std::string& usr) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto iter = values.find(usr);
+    if (iter == values.end()) {
+      return std::nullopt;
+    }
+    return iter->second;
+  }
+
+  void Insert(const std::string& usr, T value) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    values.emplace(usr, std::move(value));
+  }
+
+  void Clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    values.clear();
+  }
+
+  // Returns the cached value, or computes and caches it. compute runs without the lock held, so
+  // it may use the cache itself; concurrent misses for the same USR compute the same value.
+  template <typename Compute>
+  T Get(const std::string& usr, Compute&& compute) {
+    if (auto value = Find(usr)) {
+      return *value;
+    }
+    T value = compute();
+    Insert(usr, value);
+    return value;
+  }
+
+ private:
+  mutable std::shared_mutex mutex;
+  std::unordered_map<std::string, T> values;
+};
+
+}  // namespace Register
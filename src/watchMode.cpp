@@ -0,0 +1,374 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "watchMode.h"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include "markerPrefilter.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace Register {
+
+static std::string NormalizePath(const std::string& path) {
+  std::error_code ec;
+  fs::path absolutePath = fs::absolute(path, ec);
+  return (ec ? fs::path(path) : absolutePath).lexically_normal().string();
+}
+
+struct FileChanges {
+  // Normalized paths of all changed files.
+  std::set<std::string> files;
+  // Those of them that were created, deleted or renamed, as opposed to only written.
+  std::set<std::string> moved;
+};
+
+// Reports changed files in a set of watched directories. Uses inotify on Linux and compares
+// modification times every PollInterval elsewhere.
+class FileWatcher {
+ public:
+  FileWatcher() {
+#ifdef __linux__
+    fd = inotify_init1(IN_CLOEXEC);
+#endif
+  }
+
+  ~FileWatcher() {
+#ifdef __linux__
+    if (fd >= 0) close(fd);
+#endif
+  }
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+  // Adds directories to the watched set. Directories that are already watched are ignored.
+  void Watch(const std::set<std::string>& directories) {
+    for (const auto& directory : directories) {
+      if (!watched.insert(directory).second) {
+        continue;
+      }
+#ifdef __linux__
+      if (fd >= 0) {
+        int wd = inotify_add_watch(fd, directory.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE |
+                                       IN_DELETE);
+        if (wd >= 0) {
+          watches[wd] = directory;
+        }
+      }
+#else
+      Snapshot(directory, modifyTimes);
+#endif
+    }
+  }
+
+  // Blocks until at least one file changed and returns the normalized paths of all files that
+  // changed shortly after it, so that saving several files at once causes a single update.
+  FileChanges WaitForChanges() {
+    FileChanges changes;
+#ifdef __linux__
+    if (fd >= 0) {
+      alignas(inotify_event) char buffer[64 * 1024];
+      int timeout = -1;
+      while (true) {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, timeout) <= 0) {
+          break;
+        }
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+          break;
+        }
+        for (char* p = buffer; p < buffer + length;) {
+          auto event = reinterpret_cast<inotify_event*>(p);
+          auto directory = watches.find(event->wd);
+          if (directory != watches.end() && event->len > 0) {
+            std::string path = NormalizePath(directory->second + "/" + event->name);
+            changes.files.insert(path);
+            if ((event->mask & IN_CLOSE_WRITE) == 0) {
+              changes.moved.insert(path);
+            }
+          }
+          p += sizeof(inotify_event) + event->len;
+        }
+        timeout = DebounceMilliseconds;
+      }
+      return changes;
+    }
+#endif
+    while (changes.files.empty()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(PollIntervalMilliseconds));
+      std::unordered_map<std::string, int64_t> current;
+      for (const auto& directory : watched) {
+        Snapshot(directory, current);
+      }
+      for (const auto& [path, time] : current) {
+        auto iter = modifyTimes.find(path);
+        if (iter == modifyTimes.end()) {
+          changes.files.insert(path);
+          changes.moved.insert(path);
+        } else if (iter->second != time) {
+          changes.files.insert(path);
+        }
+      }
+      for (const auto& [path, time] : modifyTimes) {
+        if (current.find(path) == current.end()) {
+          changes.files.insert(path);
+          changes.moved.insert(path);
+        }
+      }
+      modifyTimes = std::move(current);
+    }
+    return changes;
+  }
+
+ private:
+  static constexpr int DebounceMilliseconds = 100;
+  static constexpr int PollIntervalMilliseconds = 500;
+  std::set<std::string> watched;
+  std::unordered_map<std::string, int64_t> modifyTimes;
+#ifdef __linux__
+  int fd = -1;
+  std::unordered_map<int, std::string> watches;
+#endif
+
+  static void Snapshot(const std::string& directory,
+                       std::unordered_map<std::string, int64_t>& times) {
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(directory, ec)) {
+      if (entry.is_regular_file(ec)) {
+        auto time = entry.last_write_time(ec);
+        times[NormalizePath(entry.path().string())] =
+            static_cast<int64_t>(time.time_since_epoch().count());
+      }
+    }
+  }
+};
+
+struct WatchedHeader {
+  std::unique_ptr<TranslationUnit> tu;
+  HeaderParseResult result;
+  // Normalized paths of the header and every file it includes.
+  std::set<std::string> dependencies;
+};
+
+static std::set<std::string> CollectWatchDirectories(
+    const std::vector<std::string>& watchPaths,
+    const std::map<std::string, WatchedHeader>& headers) {
+  std::set<std::string> directories;
+  std::error_code ec;
+  for (const auto& watchPath : watchPaths) {
+    if (!fs::is_directory(watchPath, ec)) {
+      directories.insert(NormalizePath(fs::path(watchPath).parent_path().string()));
+      continue;
+    }
+    directories.insert(NormalizePath(watchPath));
+    for (const auto& entry : fs::recursive_directory_iterator(watchPath, ec)) {
+      if (entry.is_directory(ec)) {
+        directories.insert(NormalizePath(entry.path().string()));
+      }
+    }
+  }
+  for (const auto& [file, header] : headers) {
+    for (const auto& dependency : header.dependencies) {
+      directories.insert(fs::path(dependency).parent_path().string());
+    }
+  }
+  return directories;
+}
+
+static bool IsHeaderPath(const std::string& file) {
+  std::string extension = fs::path(file).extension().string();
+  return extension == ".h" || extension == ".hpp";
+}
+
+// Returns true if the file was written by emit, i.e. it is one of the output paths or starts with
+// one, which covers the temporary files renamed over them and output directories.
+static bool IsOutputFile(const std::string& file, const std::vector<std::string>& outputPaths) {
+  for (const auto& outputPath : outputPaths) {
+    if (file.compare(0, outputPath.size(), outputPath) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static std::set<std::string> NormalizeHeaderPaths(const std::vector<std::string>& headFiles) {
+  std::set<std::string> paths;
+  for (const auto& file : headFiles) {
+    paths.insert(NormalizePath(file));
+  }
+  return paths;
+}
+
+int RunWatchMode(const std::vector<std::string>& watchPaths, const ProcessOptions& options,
+                 const std::vector<std::string>& outputPaths, const DiscoverFunction& discover,
+                 const EmitFunction& emit) {
+  ClangIndex index;
+  if (!index) {
+    std::cerr << "Failed to create Clang index\n";
+    return 1;
+  }
+  auto args = GetArgPointers(options.args);
+  ParseMode parseMode =
+      options.parseMode == ParseMode::Compare ? ParseMode::Full : options.parseMode;
+  std::vector<std::string> normalizedOutputPaths;
+  for (const auto& outputPath : outputPaths) {
+    normalizedOutputPaths.push_back(NormalizePath(outputPath));
+  }
+  // 保留预编译前导部分, 之后的重新解析只需处理头文件自身
+  unsigned parseOptions = GetParseOptions(parseMode) |
+                          GetExtractionParseOptions(options.extraction) |
+                          CXTranslationUnit_PrecompiledPreamble |
+                          CXTranslationUnit_CreatePreambleOnFirstParse;
+
+  auto extract = [&](WatchedHeader& header) {
+    header.result = {};
+    ExtractTranslationUnit(*header.tu, options, header.result);
+    header.dependencies.clear();
+    for (const auto& file : header.result.includedFiles) {
+      header.dependencies.insert(NormalizePath(file));
+    }
+  };
+  auto parse = [&](const std::string& file, WatchedHeader& header) {
+    std::cout << "Process file : " << file << std::endl;
+    header.tu = std::make_unique<TranslationUnit>(index, file, args, parseOptions);
+    if (!*header.tu) {
+      std::cerr << "Failed to parse file: " << file << " (error code " << header.tu->error()
+                << ")" << std::endl;
+      header.tu.reset();
+      header.result = {};
+      // 仍然监听该文件, 修改后重新解析
+      header.dependencies = {NormalizePath(file)};
+      return false;
+    }
+    extract(header);
+    return true;
+  };
+  auto reparse = [&](const std::string& file, WatchedHeader& header) {
+    if (!header.tu || !header.tu->Reparse()) {
+      return parse(file, header);
+    }
+    std::cout << "Reparse file : " << file << std::endl;
+    extract(header);
+    return true;
+  };
+  auto emitAll = [&](const std::vector<std::string>& headFiles,
+                     std::map<std::string, WatchedHeader>& headers) {
+    std::vector<HeaderParseResult> results;
+    results.reserve(headFiles.size());
+    for (const auto& file : headFiles) {
+      results.push_back(headers[file].result);
+    }
+    emit(headFiles, results);
+  };
+
+  std::vector<std::string> headFiles = discover();
+  std::map<std::string, WatchedHeader> headers;
+  for (const auto& file : headFiles) {
+    if (!parse(file, headers[file])) {
+      return 1;
+    }
+  }
+  emitAll(headFiles, headers);
+  std::set<std::string> knownHeaders = NormalizeHeaderPaths(headFiles);
+  MarkerScanner markerScanner(GetPrefilterMarkers(options.registerMacros));
+
+  FileWatcher watcher;
+  while (true) {
+    watcher.Watch(CollectWatchDirectories(watchPaths, headers));
+    std::cout << "Watching for changes..." << std::endl;
+    FileChanges fileChanges = watcher.WaitForChanges();
+    std::set<std::string>& changes = fileChanges.files;
+    // 忽略自身写出的文件, 否则每次生成都会再次触发
+    for (auto iter = changes.begin(); iter != changes.end();) {
+      iter = IsOutputFile(*iter, normalizedOutputPaths) ? changes.erase(iter) : std::next(iter);
+    }
+    if (changes.empty()) {
+      continue;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // 只有头文件被创建, 删除, 重命名, 或者未注册的头文件新增了标记时才重新发现,
+    // 其余情况只重新解析受影响的头文件
+    bool rediscover = false;
+    for (const auto& file : changes) {
+      if (IsHeaderPath(file) &&
+          (fileChanges.moved.count(file) > 0 ||
+           (knownHeaders.count(file) == 0 && markerScanner.FileContains(file)))) {
+        rediscover = true;
+        break;
+      }
+    }
+    std::vector<std::string> nextHeadFiles = rediscover ? discover() : headFiles;
+    // 类型可能改变了可复制性或所在的命名空间, 按 USR 缓存的结论不再可靠
+    ResetTypeCaches();
+    std::map<std::string, WatchedHeader> nextHeaders;
+    size_t reparsed = 0;
+    for (const auto& file : nextHeadFiles) {
+      auto iter = headers.find(file);
+      if (iter == headers.end()) {
+        parse(file, nextHeaders[file]);
+        reparsed++;
+        continue;
+      }
+      WatchedHeader header = std::move(iter->second);
+      bool changed = !header.tu;
+      for (const auto& dependency : header.dependencies) {
+        if (changes.count(dependency) > 0) {
+          changed = true;
+          break;
+        }
+      }
+      if (changed) {
+        reparse(file, header);
+        reparsed++;
+      }
+      nextHeaders[file] = std::move(header);
+    }
+    headers = std::move(nextHeaders);
+    if (!rediscover && reparsed == 0) {
+      // 例如编辑器的交换文件, 与任何头文件无关
+      continue;
+    }
+    headFiles = std::move(nextHeadFiles);
+    knownHeaders = NormalizeHeaderPaths(headFiles);
+    emitAll(headFiles, headers);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Regenerated after reparsing " << reparsed << " header(s) in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms"
+              << std::endl;
+  }
+  return 0;
+}
+
+}  // namespace Register
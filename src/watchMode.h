@@ -0,0 +1,46 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+// Returns the headers to register, in output order.
+using DiscoverFunction = std::function<std::vector<std::string>()>;
+
+// Writes the generated code for the given headers and their results.
+using EmitFunction = std::function<void(const std::vector<std::string>& headFiles,
+                                        const std::vector<HeaderParseResult>& results)>;
+
+// Parses every header once and keeps its translation unit alive with a precompiled preamble. Then
+// it waits for file changes (inotify on Linux, polling elsewhere), reparses only the headers that
+// include a changed file and emits the output again. Headers are only discovered again when a
+// header file is created, deleted or renamed, or when a header that is not registered yet is
+// written and now contains a marker. Changes to files whose path starts with one of outputPaths are
+// ignored, so that writing the output into a watched directory does not trigger another update.
+// Runs until the process is interrupted; returns non-zero if the first parse fails.
+int RunWatchMode(const std::vector<std::string>& watchPaths, const ProcessOptions& options,
+                 const std::vector<std::string>& outputPaths, const DiscoverFunction& discover,
+                 const EmitFunction& emit);
+
+}  // namespace Register
@@ -0,0 +1,434 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "workerProcesses.h"
+
+#ifdef _WIN32
+
+namespace Register {
+
+bool IsWorkerIsolationSupported() {
+  return false;
+}
+
+bool ProcessInWorkerProcesses(const std::vector<std::string>&, const ProcessOptions&,
+                              std::vector<HeaderParseResult>&) {
+  return false;
+}
+
+}  // namespace Register
+
+#else
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "memoryBudget.h"
+#include "resultSerializer.h"
+
+namespace Register {
+
+// Number of times a header is parsed before giving up on it.
+static constexpr unsigned MaxAttempts = 2;
+
+struct WorkerProcess {
+  pid_t pid = -1;
+  int taskFd = -1;
+  int resultFd = -1;
+  std::string buffer;
+  // Header being parsed, empty while the worker is idle.
+  std::optional<size_t> task;
+  std::chrono::steady_clock::time_point taskStart;
+  // Memory reserved in the budget for the task.
+  uint64_t reservation = 0;
+  bool timedOut = false;
+};
+
+bool IsWorkerIsolationSupported() {
+  return true;
+}
+
+static bool WriteAll(int fd, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t length = write(fd, data.data() + written, data.size() - written);
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length <= 0) {
+      return false;
+    }
+    written += static_cast<size_t>(length);
+  }
+  return true;
+}
+
+// 消息格式: 十进制长度, 换行, 内容
+static bool SendMessage(int fd, const std::string& payload) {
+  return WriteAll(fd, std::to_string(payload.size()) + "\n" + payload);
+}
+
+// Takes one complete message off the front of buffer, if it holds one.
+static bool TakeMessage(std::string& buffer, std::string& payload) {
+  size_t newline = buffer.find('\n');
+  if (newline == std::string::npos) {
+    return false;
+  }
+  size_t size = std::stoul(buffer.substr(0, newline));
+  if (buffer.size() - newline - 1 < size) {
+    return false;
+  }
+  payload = buffer.substr(newline + 1, size);
+  buffer.erase(0, newline + 1 + size);
+  return true;
+}
+
+// Blocks until a message arrives. Returns false once the other end is closed.
+static bool ReceiveMessage(int fd, std::string& buffer, std::string& payload) {
+  char chunk[4096];
+  while (!TakeMessage(buffer, payload)) {
+    ssize_t length = read(fd, chunk, sizeof(chunk));
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length <= 0) {
+      return false;
+    }
+    buffer.append(chunk, static_cast<size_t>(length));
+  }
+  return true;
+}
+
+static std::string SerializeResult(bool success, const HeaderParseResult& result) {
+  std::ostringstream out;
+  out << std::setprecision(17) << (success ? 1 : 0) << ' ' << result.milliseconds << ' '
+      << result.memoryBytes << ' ' << (result.comparison ? 1 : 0) << ' ';
+  if (result.comparison) {
+    out << result.comparison->fullMilliseconds << ' ' << result.comparison->fastMilliseconds
+        << ' ' << (result.comparison->identical ? 1 : 0) << ' ';
+  }
+  WriteHeaderResult(out, result);
+  return out.str();
+}
+
+static bool DeserializeResult(const std::string& payload, bool& success,
+                              HeaderParseResult& result) {
+  std::istringstream in(payload);
+  int succeeded = 0;
+  double milliseconds = 0;
+  uint64_t memoryBytes = 0;
+  int hasComparison = 0;
+  if (!(in >> succeeded >> milliseconds >> memoryBytes >> hasComparison)) {
+    return false;
+  }
+  ParseModeComparison comparison;
+  int identical = 0;
+  if (hasComparison &&
+      !(in >> comparison.fullMilliseconds >> comparison.fastMilliseconds >> identical)) {
+    return false;
+  }
+  comparison.identical = identical != 0;
+  if (!ReadHeaderResult(in, result)) {
+    return false;
+  }
+  // 解析失败的头文件没有任何结果
+  result.parsed = succeeded != 0;
+  result.milliseconds = milliseconds;
+  result.memoryBytes = memoryBytes;
+  if (hasComparison) {
+    result.comparison = comparison;
+  }
+  success = succeeded != 0;
+  return true;
+}
+
+[[noreturn]] static void RunWorker(int taskFd, int resultFd, const ProcessOptions& options) {
+  ClangIndex index;
+  auto args = GetArgPointers(options.args);
+  std::string buffer;
+  std::string headerFile;
+  while (ReceiveMessage(taskFd, buffer, headerFile)) {
+    HeaderParseResult result;
+    bool success = index && ProcessHeaderFile(index, headerFile, args, options, result);
+    std::cout.flush();
+    std::cerr.flush();
+    if (!SendMessage(resultFd, SerializeResult(success, result))) {
+      break;
+    }
+  }
+  // 不运行静态对象的析构函数, 它们属于父进程
+  _exit(0);
+}
+
+static void CloseWorker(WorkerProcess& worker) {
+  if (worker.taskFd >= 0) {
+    close(worker.taskFd);
+  }
+  if (worker.resultFd >= 0) {
+    close(worker.resultFd);
+  }
+  worker = {};
+}
+
+static bool SpawnWorker(const ProcessOptions& options, std::vector<WorkerProcess>& workers,
+                        size_t slot) {
+  int taskPipe[2];
+  int resultPipe[2];
+  if (pipe(taskPipe) != 0) {
+    return false;
+  }
+  if (pipe(resultPipe) != 0) {
+    close(taskPipe[0]);
+    close(taskPipe[1]);
+    return false;
+  }
+  // 避免缓冲区中尚未输出的内容在子进程中再输出一次
+  std::cout.flush();
+  std::cerr.flush();
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(taskPipe[0]);
+    close(taskPipe[1]);
+    close(resultPipe[0]);
+    close(resultPipe[1]);
+    return false;
+  }
+  if (pid == 0) {
+    // 关闭继承来的其他工作进程的管道, 否则它们收不到任务管道关闭的通知
+    for (auto& worker : workers) {
+      if (worker.taskFd >= 0) close(worker.taskFd);
+      if (worker.resultFd >= 0) close(worker.resultFd);
+    }
+    close(taskPipe[1]);
+    close(resultPipe[0]);
+    RunWorker(taskPipe[0], resultPipe[1], options);
+  }
+  close(taskPipe[0]);
+  close(resultPipe[1]);
+  workers[slot] = {};
+  workers[slot].pid = pid;
+  workers[slot].taskFd = taskPipe[1];
+  workers[slot].resultFd = resultPipe[0];
+  return true;
+}
+
+static std::string DescribeExit(int status, bool timedOut) {
+  if (timedOut) {
+    return "timed out";
+  }
+  if (WIFSIGNALED(status)) {
+    return std::string("crashed with signal ") + std::to_string(WTERMSIG(status)) + " (" +
+           strsignal(WTERMSIG(status)) + ")";
+  }
+  if (WIFEXITED(status)) {
+    return "exited with status " + std::to_string(WEXITSTATUS(status));
+  }
+  return "stopped unexpectedly";
+}
+
+bool ProcessInWorkerProcesses(const std::vector<std::string>& headFiles,
+                              const ProcessOptions& options,
+                              std::vector<HeaderParseResult>& results) {
+  results.clear();
+  results.resize(headFiles.size());
+  if (headFiles.empty()) {
+    return true;
+  }
+  unsigned jobs = options.jobs;
+  if (jobs == 0) {
+    jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+  jobs = static_cast<unsigned>(std::min<size_t>(jobs, headFiles.size()));
+
+  // 工作进程退出后再写任务管道不应终止主进程
+  auto previousHandler = std::signal(SIGPIPE, SIG_IGN);
+
+  ParseSchedule schedule = GetParseSchedule(headFiles, options);
+  std::deque<size_t> pending(schedule.order.begin(), schedule.order.end());
+  MemoryBudget budget(options.maxMemory);
+  std::vector<unsigned> attempts(headFiles.size(), 0);
+  bool failed = false;
+
+  std::vector<WorkerProcess> workers(jobs);
+  auto assign = [&](WorkerProcess& worker) {
+    if (pending.empty()) {
+      // 没有更多任务, 关闭任务管道让工作进程退出
+      close(worker.taskFd);
+      worker.taskFd = -1;
+      return;
+    }
+    size_t i = pending.front();
+    uint64_t reservation = schedule.memoryEstimates[i] > 0 ? schedule.memoryEstimates[i]
+                                                           : budget.GetUnknownEstimate();
+    if (!budget.TryAcquire(reservation)) {
+      // 超出内存预算, 工作进程保持空闲, 直到其他任务完成
+      return;
+    }
+    pending.pop_front();
+    attempts[i]++;
+    worker.task = i;
+    worker.reservation = reservation;
+    worker.taskStart = std::chrono::steady_clock::now();
+    // 写入失败说明工作进程已经退出, 随后读到文件结束时按崩溃处理
+    SendMessage(worker.taskFd, headFiles[i]);
+  };
+  auto spawn = [&](size_t slot) {
+    if (!SpawnWorker(options, workers, slot)) {
+      std::cerr << "Failed to start worker process: " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    assign(workers[slot]);
+    return true;
+  };
+  auto assignIdle = [&]() {
+    for (auto& worker : workers) {
+      if (worker.pid > 0 && !worker.task && worker.taskFd >= 0) {
+        assign(worker);
+      }
+    }
+  };
+
+  size_t running = 0;
+  for (size_t slot = 0; slot < workers.size(); ++slot) {
+    if (spawn(slot)) {
+      running++;
+    }
+  }
+  if (running == 0) {
+    std::signal(SIGPIPE, previousHandler);
+    return false;
+  }
+
+  std::vector<pollfd> pfds;
+  std::vector<size_t> slots;
+  char chunk[64 * 1024];
+  while (running > 0) {
+    pfds.clear();
+    slots.clear();
+    for (size_t slot = 0; slot < workers.size(); ++slot) {
+      if (workers[slot].pid > 0) {
+        pfds.push_back({workers[slot].resultFd, POLLIN, 0});
+        slots.push_back(slot);
+      }
+    }
+    int timeout = options.workerTimeout > 0 ? 1000 : -1;
+    if (poll(pfds.data(), pfds.size(), timeout) < 0 && errno != EINTR) {
+      break;
+    }
+
+    for (size_t p = 0; p < pfds.size(); ++p) {
+      WorkerProcess& worker = workers[slots[p]];
+      if (pfds[p].revents == 0) {
+        continue;
+      }
+      ssize_t length = read(worker.resultFd, chunk, sizeof(chunk));
+      if (length < 0 && errno == EINTR) {
+        continue;
+      }
+      if (length > 0) {
+        worker.buffer.append(chunk, static_cast<size_t>(length));
+        std::string payload;
+        if (worker.task && TakeMessage(worker.buffer, payload)) {
+          size_t i = *worker.task;
+          bool success = false;
+          if (!DeserializeResult(payload, success, results[i])) {
+            std::cerr << "Invalid result from worker process for " << headFiles[i] << std::endl;
+            results[i] = {};
+          }
+          failed = failed || !success;
+          budget.RecordMeasured(results[i].memoryBytes);
+          budget.Release(worker.reservation);
+          worker.task.reset();
+          assign(worker);
+          assignIdle();
+        }
+        continue;
+      }
+
+      // 工作进程退出: 任务全部完成, 或者在处理某个头文件时崩溃
+      int status = 0;
+      waitpid(worker.pid, &status, 0);
+      std::optional<size_t> task = worker.task;
+      uint64_t reservation = worker.reservation;
+      bool timedOut = worker.timedOut;
+      CloseWorker(worker);
+      running--;
+      if (!task) {
+        continue;
+      }
+      size_t i = *task;
+      budget.Release(reservation);
+      results[i] = {};
+      std::cerr << "Worker process " << DescribeExit(status, timedOut) << " while parsing "
+                << headFiles[i];
+      if (attempts[i] < MaxAttempts) {
+        std::cerr << ", retrying" << std::endl;
+        pending.push_front(i);
+      } else {
+        std::cerr << ", giving up" << std::endl;
+        failed = true;
+      }
+      if (!pending.empty() && spawn(slots[p])) {
+        running++;
+      }
+      assignIdle();
+    }
+
+    if (options.workerTimeout > 0) {
+      auto now = std::chrono::steady_clock::now();
+      for (auto& worker : workers) {
+        if (worker.pid > 0 && worker.task && !worker.timedOut &&
+            now - worker.taskStart > std::chrono::seconds(options.workerTimeout)) {
+          // 杀死后读到文件结束, 与崩溃一样处理
+          worker.timedOut = true;
+          kill(worker.pid, SIGKILL);
+        }
+      }
+    }
+  }
+
+  // 意外退出循环时不留下子进程
+  for (auto& worker : workers) {
+    if (worker.pid > 0) {
+      kill(worker.pid, SIGKILL);
+      waitpid(worker.pid, nullptr, 0);
+      CloseWorker(worker);
+    }
+  }
+  std::signal(SIGPIPE, previousHandler);
+  for (size_t i : pending) {
+    std::cerr << "Failed to parse " << headFiles[i] << ": no worker process left" << std::endl;
+    failed = true;
+  }
+  return !failed;
+}
+
+}  // namespace Register
+
+#endif
@@ -0,0 +1,42 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (C) 2021 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the Apache License, Version 2.0 (the "License"); you may not
+//  use this file except in compliance with the License. You may obtain a copy
+//  of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+//  unless required by applicable law or agreed to in writing, software
+//  distributed under the license is distributed on an "as is" basis, without
+//  warranties or conditions of any kind, either express or implied. see the
+//  license for the specific language governing permissions and limitations
+//  under the license.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "headerProcessor.h"
+
+namespace Register {
+
+// Returns true if headers can be parsed in worker processes on this platform.
+bool IsWorkerIsolationSupported();
+
+// Forks options.jobs worker processes and hands them one header at a time over a pipe. Each
+// worker parses with its own CXIndex and sends the serialized result back, so a header that
+// crashes libclang only takes down its worker. A crashed worker is replaced and its header is
+// retried once in a fresh worker; a worker that spends more than options.workerTimeout seconds
+// on one header is killed and treated the same way. The remaining headers keep going either
+// way. With options.maxMemory a worker is left idle while the next header's expected memory
+// does not fit next to the headers in flight. results[i] always belongs to headFiles[i].
+// Returns false if any header failed.
+bool ProcessInWorkerProcesses(const std::vector<std::string>& headFiles,
+                              const ProcessOptions& options,
+                              std::vector<HeaderParseResult>& results);
+
+}  // namespace Register